@@ -12,6 +12,7 @@
 #include "cirMgr.h"
 #include "cirGate.h"
 #include "cirCmd.h"
+#include "myZStream.h"
 #include "util.h"
 
 using namespace std;
@@ -30,7 +31,10 @@ initCirCmd()
          cmdMgr->regCmd("CIRSTRash", 6, new CirStrashCmd) &&
          cmdMgr->regCmd("CIRSIMulate", 6, new CirSimCmd) &&
          cmdMgr->regCmd("CIRFraig", 4, new CirFraigCmd) &&
-         cmdMgr->regCmd("CIRWrite", 4, new CirWriteCmd)
+         cmdMgr->regCmd("CIRCompact", 4, new CirCompactCmd) &&
+         cmdMgr->regCmd("CIRWrite", 4, new CirWriteCmd) &&
+         cmdMgr->regCmd("CIRSAve", 5, new CirSaveCmd) &&
+         cmdMgr->regCmd("CIRLoad", 4, new CirLoadCmd)
       )) {
       cerr << "Registering \"cir\" commands fails... exiting" << endl;
       return false;
@@ -54,7 +58,8 @@ enum CirCmdState
 static CirCmdState curCmd = CIRINIT;
 
 //----------------------------------------------------------------------
-//    CIRRead <(string fileName)> [-Replace]
+//    CIRRead <(string fileName)> [-Replace] [-Mmap] [-Lazy] [-Strash]
+//            [-Pipeline] [-Threads (int n)]
 //----------------------------------------------------------------------
 CmdExecStatus
 CirReadCmd::exec(const string& option)
@@ -67,12 +72,39 @@ CirReadCmd::exec(const string& option)
       return CmdExec::errorOption(CMD_OPT_MISSING, "");
 
    bool doReplace = false;
+   int mode = READ_STREAM, nThreads = 1;
    string fileName;
    for (size_t i = 0, n = options.size(); i < n; ++i) {
       if (myStrNCmp("-Replace", options[i], 2) == 0) {
          if (doReplace) return CmdExec::errorOption(CMD_OPT_EXTRA,options[i]);
          doReplace = true;
       }
+      else if (myStrNCmp("-Mmap", options[i], 2) == 0) {
+         if (mode & READ_MMAP)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         mode |= READ_MMAP;
+      }
+      else if (myStrNCmp("-Lazy", options[i], 2) == 0) {
+         if (mode & READ_LAZY_SYMBOL)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         mode |= READ_LAZY_SYMBOL;
+      }
+      else if (myStrNCmp("-Strash", options[i], 2) == 0) {
+         if (mode & READ_STRASH)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         mode |= READ_STRASH;
+      }
+      else if (myStrNCmp("-Pipeline", options[i], 2) == 0) {
+         if (mode & READ_PIPELINE)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         mode |= READ_PIPELINE;
+      }
+      else if (myStrNCmp("-Threads", options[i], 2) == 0) {
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!myStr2Int(options[i], nThreads) || nThreads < 1)
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+      }
       else {
          if (fileName.size())
             return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
@@ -93,13 +125,14 @@ CirReadCmd::exec(const string& option)
    }
    cirMgr = new CirMgr;
 
-   if (!cirMgr->readCircuit(fileName)) {
+   if (!cirMgr->readCircuit(fileName, mode, nThreads)) {
       curCmd = CIRINIT;
       delete cirMgr; cirMgr = 0;
       return CMD_EXEC_ERROR;
    }
 
-   curCmd = CIRREAD;
+   // a hash-consed netlist needs no separate CIRSTRash pass
+   curCmd = (mode & (READ_STRASH | READ_PIPELINE)) ? CIRSTRASH : CIRREAD;
 
    return CMD_EXEC_DONE;
 }
@@ -107,7 +140,9 @@ CirReadCmd::exec(const string& option)
 void
 CirReadCmd::usage(ostream& os) const
 {
-   os << "Usage: CIRRead <(string fileName)> [-Replace]" << endl;
+   os << "Usage: CIRRead <(string fileName)> [-Replace] [-Mmap] [-Lazy] "
+      << "[-Strash]" << endl
+      << "               [-Pipeline] [-Threads (int n)]" << endl;
 }
 
 void
@@ -134,14 +169,18 @@ CirPrintCmd::exec(const string& option)
    }
    if (token.empty() || myStrNCmp("-Summary", token, 2) == 0)
       cirMgr->printSummary();
-   else if (myStrNCmp("-Netlist", token, 2) == 0)
+   else if (myStrNCmp("-Netlist", token, 2) == 0) {
+      cirMgr->unpack();
       cirMgr->printNetlist();
+   }
    else if (myStrNCmp("-PI", token, 3) == 0)
       cirMgr->printPIs();
    else if (myStrNCmp("-PO", token, 3) == 0)
       cirMgr->printPOs();
-   else if (myStrNCmp("-FLoating", token, 3) == 0)
+   else if (myStrNCmp("-FLoating", token, 3) == 0) {
+      cirMgr->unpack();
       cirMgr->printFloatGates();
+   }
    else if (myStrNCmp("-FECpairs", token, 4) == 0)
       cirMgr->printFECPairs();
    else
@@ -182,6 +221,7 @@ CirGateCmd::exec(const string& option)
    if (options.empty())
       return CmdExec::errorOption(CMD_OPT_MISSING, "");
 
+   cirMgr->unpack();
    int gateId = -1, level = 0;
    bool doFanin = false, doFanout = false;
    CirGate* thisGate = 0;
@@ -267,6 +307,7 @@ CirSweepCmd::exec(const string& option)
       return CmdExec::errorOption(CMD_OPT_EXTRA, options[0]);
 
    assert(curCmd != CIRINIT);
+   cirMgr->unpack();
    cirMgr->sweep();
 
    return CMD_EXEC_DONE;
@@ -308,6 +349,7 @@ CirOptCmd::exec(const string& option)
            << endl;
       return CMD_EXEC_ERROR;
    }
+   cirMgr->unpack();
    cirMgr->optimize();
    curCmd = CIROPT;
 
@@ -354,6 +396,7 @@ CirStrashCmd::exec(const string& option)
            << endl;
       return CMD_EXEC_ERROR;
    }
+   cirMgr->unpack();
    cirMgr->strash();
    curCmd = CIRSTRASH;
 
@@ -374,8 +417,9 @@ CirStrashCmd::help() const
 }
 
 //----------------------------------------------------------------------
-//    CIRSIMulate <-Random | -File <string patternFile>>
-//                [-Output (string logFile)]
+//    CIRSIMulate <-Random | -File <string patternFile> | -FLip <(int id)>...>
+//                [-Output (string logFile)] [-Threads (int n) [-Level]]
+//                [-Seed (int seed)]
 //----------------------------------------------------------------------
 CmdExecStatus
 CirSimCmd::exec(const string& option)
@@ -388,21 +432,24 @@ CirSimCmd::exec(const string& option)
    vector<string> options;
    CmdExec::lexOptions(option, options);
 
-   ifstream patternFile;
+   ZInStream patternFile;
    ofstream logFile;
-   bool doRandom = false, doFile = false, doLog = false;
+   bool doRandom = false, doFile = false, doLog = false, doLevel = false;
+   int nThreads = 1, seed;
+   bool doSeed = false;
+   GateList flips;
    for (size_t i = 0, n = options.size(); i < n; ++i) {
       if (myStrNCmp("-Random", options[i], 2) == 0) {
-         if (doRandom || doFile)
+         if (doRandom || doFile || flips.size())
             return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
          doRandom = true;
       }
       else if (myStrNCmp("-File", options[i], 2) == 0) {
-         if (doRandom || doFile)
+         if (doRandom || doFile || flips.size())
             return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
          if (++i == n)
             return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
-         patternFile.open(options[i].c_str(), ios::in);
+         patternFile.open(options[i]);
          if (!patternFile)
             return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, options[i]);
          doFile = true;
@@ -417,17 +464,63 @@ CirSimCmd::exec(const string& option)
             return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, options[i]);
          doLog = true;
       }
+      else if (myStrNCmp("-Threads", options[i], 2) == 0) {
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!myStr2Int(options[i], nThreads) || nThreads < 1)
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+      }
+      else if (myStrNCmp("-Level", options[i], 2) == 0) {
+         if (doLevel)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         doLevel = true;
+      }
+      else if (myStrNCmp("-Seed", options[i], 2) == 0) {
+         if (doSeed)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!myStr2Int(options[i], seed))
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+         doSeed = true;
+      }
+      else if (myStrNCmp("-FLip", options[i], 3) == 0) {
+         if (doRandom || doFile || flips.size())
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+         int id;
+         while (i + 1 < n && myStr2Int(options[i+1], id))
+            flips.push_back(id), ++i;
+         if (flips.empty())
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i]);
+      }
       else
          return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
    }
 
-   if (!doRandom && !doFile)
+   if (!doRandom && !doFile && flips.empty())
       return CmdExec::errorOption(CMD_OPT_MISSING, "");
 
+   // flipping updates the patterns of the last simulation in place
+   if (flips.size()) {
+      if (doLog)
+         return CmdExec::errorOption(CMD_OPT_ILLEGAL, "-Output");
+      if (curCmd != CIRSIMULATE) {
+         cerr << "Error: circuit has not been simulated!!" << endl;
+         return CMD_EXEC_ERROR;
+      }
+      if (!cirMgr->flipSim(flips))
+         return CMD_EXEC_ERROR;
+      return CMD_EXEC_DONE;
+   }
+
    assert (curCmd != CIRINIT);
    if (doLog)
       cirMgr->setSimLog(&logFile);
    else cirMgr->setSimLog(0);
+   // splitting levels needs the flat fanins of the simulation schedule
+   if (doLevel) cirMgr->unpack();
+   cirMgr->setSimThreads(nThreads, doLevel);
+   if (doSeed) cirMgr->setSimSeed((unsigned)seed);
 
    if (doRandom)
       cirMgr->randomSim();
@@ -442,8 +535,11 @@ CirSimCmd::exec(const string& option)
 void
 CirSimCmd::usage(ostream& os) const
 {
-   os << "Usage: CIRSIMulate <-Random | -File <string patternFile>>\n"
-      << "                   [-Output (string logFile)]" << endl;
+   os << "Usage: CIRSIMulate <-Random | -File <string patternFile> |\n"
+      << "                    -FLip <(int id)>...>\n"
+      << "                   [-Output (string logFile)]"
+      << " [-Threads (int n) [-Level]]\n"
+      << "                   [-Seed (int seed)]" << endl;
 }
 
 void
@@ -454,7 +550,7 @@ CirSimCmd::help() const
 }
 
 //----------------------------------------------------------------------
-//    CIRFraig
+//    CIRFraig [-Compact]
 //----------------------------------------------------------------------
 CmdExecStatus
 CirFraigCmd::exec(const string& option)
@@ -467,14 +563,23 @@ CirFraigCmd::exec(const string& option)
    vector<string> options;
    CmdExec::lexOptions(option, options);
 
-   if (!options.empty())
-      return CmdExec::errorOption(CMD_OPT_EXTRA, options[0]);
+   bool doCompact = false;
+   for (size_t i = 0, n = options.size(); i < n; ++i) {
+      if (myStrNCmp("-Compact", options[i], 2) == 0) {
+         if (doCompact)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         doCompact = true;
+      }
+      else return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+   }
 
    if (curCmd != CIRSIMULATE) {
       cerr << "Error: circuit is not yet simulated!!" << endl;
       return CMD_EXEC_ERROR;
    }
+   cirMgr->unpack();
    cirMgr->fraig();
+   if (doCompact) cirMgr->compact();
    curCmd = CIRFRAIG;
 
    return CMD_EXEC_DONE;
@@ -483,7 +588,7 @@ CirFraigCmd::exec(const string& option)
 void
 CirFraigCmd::usage(ostream& os) const
 {
-   os << "Usage: CIRFraig" << endl;
+   os << "Usage: CIRFraig [-Compact]" << endl;
 }
 
 void
@@ -494,7 +599,53 @@ CirFraigCmd::help() const
 }
 
 //----------------------------------------------------------------------
-//    CIRWrite [(int gateId)][-Output (string aagFile)]
+//    CIRCompact [-Pack]
+//----------------------------------------------------------------------
+CmdExecStatus
+CirCompactCmd::exec(const string& option)
+{
+   if (!cirMgr) {
+      cerr << "Error: circuit is not yet constructed!!" << endl;
+      return CMD_EXEC_ERROR;
+   }
+   // check option
+   vector<string> options;
+   CmdExec::lexOptions(option, options);
+
+   bool doPack = false;
+   for (size_t i = 0, n = options.size(); i < n; ++i) {
+      if (myStrNCmp("-Pack", options[i], 2) == 0) {
+         if (doPack)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         doPack = true;
+      }
+      else return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+   }
+
+   assert(curCmd != CIRINIT);
+   cirMgr->unpack();
+   cirMgr->compact();
+   if (doPack && !cirMgr->pack())
+      return CMD_EXEC_ERROR;
+
+   return CMD_EXEC_DONE;
+}
+
+void
+CirCompactCmd::usage(ostream& os) const
+{
+   os << "Usage: CIRCompact [-Pack]" << endl;
+}
+
+void
+CirCompactCmd::help() const
+{
+   cout << setw(15) << left << "CIRCompact: "
+        << "renumber the live gates in topological order\n";
+}
+
+//----------------------------------------------------------------------
+//    CIRWrite [(int gateId)][-Output (string aagFile)][-Binary]
 //----------------------------------------------------------------------
 CmdExecStatus
 CirWriteCmd::exec(const string& option)
@@ -511,7 +662,7 @@ CirWriteCmd::exec(const string& option)
       cirMgr->writeAag(cout);
       return CMD_EXEC_DONE;
    }
-   bool hasFile = false;
+   bool hasFile = false, doBinary = false;
    int gateId;
    CirGate *thisGate = NULL;
    ofstream outfile;
@@ -521,11 +672,16 @@ CirWriteCmd::exec(const string& option)
             return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
          if (++i == n)
             return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
-         outfile.open(options[i].c_str(), ios::out);
+         outfile.open(options[i].c_str(), ios::out | ios::binary);
          if (!outfile)
             return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, options[1]);
          hasFile = true;
       }
+      else if (myStrNCmp("-Binary", options[i], 2) == 0) {
+         if (doBinary)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         doBinary = true;
+      }
       else if (myStr2Int(options[i], gateId) && gateId >= 0) {
          if (thisGate != NULL)
             return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
@@ -542,12 +698,16 @@ CirWriteCmd::exec(const string& option)
       else return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
    }
 
+   ostream& os = hasFile ? (ostream&)outfile : cout;
    if (!thisGate) {
-      assert (hasFile);
-      cirMgr->writeAag(outfile);
+      if (doBinary) cirMgr->writeAig(os);
+      else cirMgr->writeAag(os);
+   }
+   else {
+      cirMgr->unpack();
+      if (doBinary) cirMgr->writeGateAig(os, thisGate);
+      else cirMgr->writeGate(os, thisGate);
    }
-   else if (hasFile) cirMgr->writeGate(outfile, thisGate);
-   else cirMgr->writeGate(cout, thisGate);
 
    return CMD_EXEC_DONE;
 }
@@ -555,13 +715,126 @@ CirWriteCmd::exec(const string& option)
 void
 CirWriteCmd::usage(ostream& os) const
 {
-   os << "Usage: CIRWrite [(int gateId)][-Output (string aagFile)]" << endl;
+   os << "Usage: CIRWrite [(int gateId)][-Output (string aagFile)][-Binary]"
+      << endl;
 }
 
 void
 CirWriteCmd::help() const
 {
    cout << setw(15) << left << "CIRWrite: "
-        << "write the netlist to an ASCII AIG file (.aag)\n";
+        << "write the netlist to an AIGER file (.aag, or .aig with -Binary)\n";
+}
+
+
+//----------------------------------------------------------------------
+//    CIRSAve <(string imageFile)>
+//----------------------------------------------------------------------
+CmdExecStatus
+CirSaveCmd::exec(const string& option)
+{
+   if (!cirMgr) {
+      cerr << "Error: circuit is not yet constructed!!" << endl;
+      return CMD_EXEC_ERROR;
+   }
+   // check option
+   string token;
+   if (!CmdExec::lexSingleOption(option, token, false))
+      return CMD_EXEC_ERROR;
+   if (token.empty())
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+
+   cirMgr->unpack();
+   if (!cirMgr->saveImage(token, curCmd))
+      return CMD_EXEC_ERROR;
+
+   return CMD_EXEC_DONE;
+}
+
+void
+CirSaveCmd::usage(ostream& os) const
+{
+   os << "Usage: CIRSAve <(string imageFile)>" << endl;
+}
+
+void
+CirSaveCmd::help() const
+{
+   cout << setw(15) << left << "CIRSAve: "
+        << "save the circuit and its analysis to a binary image\n";
+}
+
+//----------------------------------------------------------------------
+//    CIRLoad <(string imageFile)> [-Source (string aagFile)] [-Replace]
+//----------------------------------------------------------------------
+CmdExecStatus
+CirLoadCmd::exec(const string& option)
+{
+   // check option
+   vector<string> options;
+   if (!CmdExec::lexOptions(option, options))
+      return CMD_EXEC_ERROR;
+   if (options.empty())
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+
+   bool doReplace = false;
+   string fileName, srcFile;
+   for (size_t i = 0, n = options.size(); i < n; ++i) {
+      if (myStrNCmp("-Replace", options[i], 2) == 0) {
+         if (doReplace) return CmdExec::errorOption(CMD_OPT_EXTRA,options[i]);
+         doReplace = true;
+      }
+      else if (myStrNCmp("-Source", options[i], 2) == 0) {
+         if (srcFile.size())
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         srcFile = options[i];
+      }
+      else {
+         if (fileName.size())
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+         fileName = options[i];
+      }
+   }
+   if (fileName.empty())
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+
+   if (cirMgr != 0) {
+      if (doReplace) {
+         cerr << "Note: original circuit is replaced..." << endl;
+         curCmd = CIRINIT;
+         delete cirMgr; cirMgr = 0;
+      }
+      else {
+         cerr << "Error: circuit already exists!!" << endl;
+         return CMD_EXEC_ERROR;
+      }
+   }
+   cirMgr = new CirMgr;
+
+   int stage = CIRREAD;
+   if (!cirMgr->loadImage(fileName, srcFile, stage)) {
+      curCmd = CIRINIT;
+      delete cirMgr; cirMgr = 0;
+      return CMD_EXEC_ERROR;
+   }
+   curCmd = (stage > CIRINIT && stage < CIRCMDTOT) ? CirCmdState(stage)
+                                                   : CIRREAD;
+
+   return CMD_EXEC_DONE;
+}
+
+void
+CirLoadCmd::usage(ostream& os) const
+{
+   os << "Usage: CIRLoad <(string imageFile)> [-Source (string aagFile)] "
+      << "[-Replace]" << endl;
 }
 
+void
+CirLoadCmd::help() const
+{
+   cout << setw(15) << left << "CIRLoad: "
+        << "restore a circuit from a binary image\n";
+}
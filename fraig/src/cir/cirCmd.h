@@ -19,6 +19,9 @@ CmdClass(CirOptCmd);
 CmdClass(CirStrashCmd);
 CmdClass(CirSimCmd);
 CmdClass(CirFraigCmd);
+CmdClass(CirCompactCmd);
 CmdClass(CirWriteCmd);
+CmdClass(CirSaveCmd);
+CmdClass(CirLoadCmd);
 
 #endif // CIR_CMD_H
@@ -23,6 +23,20 @@ class SatSolver;
 typedef vector<int> GateList;
 typedef vector<CirGate*> GatePointerList;
 
+enum CirReadMode {
+    READ_STREAM = 0,            // getline + stringstream per line
+    READ_MMAP = 1 << 0,         // map the file and scan integers in place
+    READ_LAZY_SYMBOL = 1 << 1,  // read the symbol table on first lookup
+    READ_STRASH = 1 << 2,       // hash-cons ANDs as they are created
+    READ_PIPELINE = 1 << 3      // hash, link and levelize on a 2nd thread
+};
+
+// One step of the levelized simulation schedule: val[out] = lid0 & lid1,
+// the literals' low bits inverting their fanins. A PO uses lid1 = 1.
+struct CirSimOp {
+    int out, lid0, lid1;
+};
+
 enum GateType {
     GATE_AIG,
     GATE_CONST0,
@@ -51,12 +51,14 @@ static HashMap<UnorderedPair, int> strashMap;
 // _floatList may be changed.
 // _unusedList and _undefList won't be changed
 
+// A gate merges into one met earlier in the DFS order, so the order stays
+// valid for the rest of the pass.
 void CirMgr::strash() {
-    resetVisit();
+    GateList dfs = dfsList();
     strashMap.init(_MaxIndex);
 
-    for (int i = 0; i < _LOutputs.size(); i++)
-        strash(toID(_LOutputs[i]));
+    for (int i = 0; i < dfs.size(); i++)
+        strash(dfs[i]);
 }
 
 vector<Var> gateVar;
@@ -69,12 +71,13 @@ void CirMgr::fraig() {
         int i, j;
         for (i = 0; iti != FECGroup.end(); ++iti, ++i) {
             int lid0 = *iti;
-            if (replaced(i)) continue;
+            // a member may have died with the cone of an earlier merge
+            if (replaced(i) || !active(toID(lid0))) continue;
             list<int>::iterator itj = iti;
             int fails = 0;
             for (++itj, j = 0; itj != FECGroup.end(); ++itj, ++j) {
                 int lid1 = *itj;
-                if (replaced(j)) continue;
+                if (replaced(j) || !active(toID(lid1))) continue;
                 if (proveFEC(lid0, lid1)) {
                     fraigReplace(lid0 ^ (lid1 & 1), toID(lid1));
                     replace(j);
@@ -111,19 +114,108 @@ bool CirMgr::proveFEC(int lid0, int lid1) {
 /********************************************/
 /*   Private member functions about fraig   */
 /********************************************/
+// Structural hashing while reading (READ_STRASH). An AND whose fanins are
+// already built is simplified and hashed right away; one that refers to a
+// later definition (possible in ASCII AIGER) is queued until the AND
+// section is done and then built in topological order by strashPending().
+// _strashLit[id] is the literal a merged or simplified AND was mapped to.
+void CirMgr::strashAIG(int lid, int lid0, int lid1, int line) {
+    if (_strashLit.empty()) {
+        _strashLit.assign(_MaxIndex + 1, -1);
+        strashMap.init(_AIGNum + 1);
+    }
+    int a = strashLit(lid0), b = strashLit(lid1);
+    if (a < 0 || b < 0) {
+        int def[4] = {lid, lid0, lid1, line};
+        _strashQueue.insert(_strashQueue.end(), def, def + 4);
+    } else {
+        hashAIG(lid, a, b, line);
+    }
+}
 
-void CirMgr::strash(int id) {
-    if (visited(id)) return;
-    visit(id);
-    vector<int>& LFanIn = LFanInOf(id);
+// a AND with canonical fanins: constant/identity rules first, then the
+// hash table; only a new structure gets a CirAIG
+void CirMgr::hashAIG(int lid, int lid0, int lid1, int line) {
+    int id = toID(lid);
+    if (lid0 > lid1) swap(lid0, lid1);
+    if (lid0 == 0 || lid0 == (lid1 ^ 1)) {
+        _strashLit[id] = 0;
+    } else if (lid0 == 1 || lid0 == lid1) {
+        _strashLit[id] = lid1;
+    } else {
+        UnorderedPair p(lid0, lid1);
+        if (strashMap.count(p)) {
+            _strashLit[id] = toLID(strashMap[p]);
+            return;
+        }
+        strashMap[p] = id;
+        _LAIGs.push_back(toLID(id));
+        createGate(GATE_AIG, id)->setLineNo(line);
+        _active[id] = true;
+        setFanIn(id, lid0, lid1);
+        if (_pipe) linkAIG(id);
+    }
+}
+
+// lid rewritten onto its canonical driver, or -1 while that driver is an
+// AND that has not been built yet
+int CirMgr::strashLit(int lid) const {
+    int id = toID(lid);
+    if (id > _MaxIndex) return lid;
+    if (_strashLit[id] >= 0) return _strashLit[id] ^ isInv(lid);
+    return _gates[id] ? lid : -1;
+}
+
+void CirMgr::strashPending() {
+    if (_strashLit.empty()) _strashLit.assign(_MaxIndex + 1, -1);
+
+    // 0: queued, 1: on the stack, 2: built
+    int n = _strashQueue.size() / 4;
+    vector<int> def(_MaxIndex + 1, -1);
+    vector<char> state(n, 0);
+    for (int i = 0; i < n; ++i)
+        def[toID(_strashQueue[4 * i])] = i;
+
+    vector<int> stack;
+    for (int i = 0; i < n; ++i) {
+        if (state[i]) continue;
+        stack.push_back(i), state[i] = 1;
+        while (!stack.empty()) {
+            int t = stack.back();
+            const int* d = &_strashQueue[4 * t];
+            // descend one fanin at a time so that state 1 means an ancestor
+            bool ready = true;
+            for (int k = 1; k <= 2 && ready; ++k) {
+                int f = toID(d[k]) > _MaxIndex ? -1 : def[toID(d[k])];
+                if (f >= 0 && state[f] == 0) {
+                    stack.push_back(f), state[f] = 1;
+                    ready = false;
+                }
+            }
+            if (!ready) continue;
+            stack.pop_back(), state[t] = 2;
+            // undefined (or cyclic) fanins are kept as they are
+            int a = strashLit(d[1]), b = strashLit(d[2]);
+            hashAIG(d[0], a < 0 ? d[1] : a, b < 0 ? d[2] : b, d[3]);
+        }
+    }
 
-    for (int i = 0; i < LFanIn.size(); i++)
-        if (_active[toID(LFanIn[i])]) strash(toID(LFanIn[i]));
+    for (int i = 0; i < _LOutputs.size(); ++i) {
+        int lid = strashLit(_LOutputs[i]);
+        if (lid >= 0) _LOutputs[i] = lid;
+    }
+    GateList().swap(_strashLit);
+    GateList().swap(_strashQueue);
+    strashMap.reset();
+}
 
-    if (LFanIn.size() == 2) {
-        UnorderedPair p(LFanIn[0], LFanIn[1]);
+void CirMgr::strash(int id) {
+    if (isAIG(id)) {
+        UnorderedPair p(_fanin0[id], _fanin1[id]);
 
-        if (strashMap.count(p))
+        // the first gate with this key may have died with the cone of an
+        // earlier merge; then this one takes its place
+        if (strashMap.count(p) && active(strashMap[p]))
             strashReplace(toLID(strashMap[p]), id);
         else
             strashMap[p] = id;
@@ -131,28 +223,22 @@ void CirMgr::strash(int id) {
 }
 
 void CirMgr::buildSolver(SatSolver& ss, int id) {
-    if (visited(id)) return;
-    visit(id);
-
-    if (id == 0) {
-        gateVar[0] = ss.newVar();
-        ss.assumeProperty(gateVar[0], false);
-        return;
-    }
-
-    assert(gate(id) != nullptr);
-
-    GateList& LFanIn = LFanInOf(id);
-    for (int i = 0; i < LFanIn.size(); i++)
-        if (active(toID(LFanIn[i]))) buildSolver(ss, toID(LFanIn[i]));
-
-    gateVar[id] = ss.newVar();
-    if (LFanIn.size() == 2) {
-        int lid0 = LFanIn[0];
-        int lid1 = LFanIn[1];
-        ss.addAigCNF(gateVar[id], gateVar[toID(lid0)], lid0 & 1,
-                     gateVar[toID(lid1)], lid1 & 1);
-    }
+    auto leave = [&](int id) {
+        gateVar[id] = ss.newVar();
+        if (id == 0) {
+            ss.assumeProperty(gateVar[0], false);
+            return;
+        }
+        assert(gate(id) != nullptr);
+        if (isAIG(id)) {
+            int lid0 = _fanin0[id];
+            int lid1 = _fanin1[id];
+            ss.addAigCNF(gateVar[id], gateVar[toID(lid0)], lid0 & 1,
+                         gateVar[toID(lid1)], lid1 & 1);
+        }
+    };
+    walk(id, [this](int id) { return firstVisit(id); },
+         [this](int in) { return active(in); }, leave);
 }
 
 void CirMgr::strashReplace(int lidNew, int idOld) {
@@ -27,13 +27,19 @@ extern CirMgr* cirMgr;
 /**************************************/
 /*   class CirGate member functions   */
 /**************************************/
+const char* CirGate::symbol() const { return cirMgr->getSymbol(_id); }
+int CirGate::fanInSize() const { return cirMgr->fanInSize(_id); }
+int CirGate::fanIn(int i) const { return cirMgr->fanIn(_id, i); }
+int CirGate::fanOutSize() const { return cirMgr->fanOutSize(_id); }
+int CirGate::fanOut(int i) const { return cirMgr->fanOut(_id, i); }
+
 void CirGate::reportGate() const {
     string gateReport;
     cout << "==================================================" << endl;
     cout << "= ";
 
     gateReport += typeString() + "(" + to_string(_id) + ")";
-    if (hasSymbol()) gateReport += "\"" + _symbol + "\"";
+    if (hasSymbol()) gateReport += "\"" + string(symbol()) + "\"";
     gateReport += ", line " + to_string(_lineNo);
 
     cout << left << setw(47) << gateReport;
@@ -61,96 +67,74 @@ void CirGate::reportGate() const {
     cout << "=" << endl;
     cout << "==================================================" << endl;
 }
-void CirGate::reportFanin(int level) const {
-    assert(level >= 0);
+// Print the fanin (or fanout) cone of root down to depth levels, each gate
+// indented by its level. A gate whose cone was printed in full before shows
+// "(*)" instead, unless it is a PI (PO for fanouts) or on the last level.
+// The cone is walked with an explicit stack, so its depth is not limited
+// by the call stack.
+static void reportCone(const CirGate* root, int depth, bool fanout) {
+    struct Frame {
+        const CirGate* gate;
+        int i;
+    };
+    vector<Frame> stack;
     vector<bool> vis(cirMgr->size() + 1, false);
-    reportFanin(level, 0, vis);
-}
-bool CirGate::reportFanin(int depth, int cur, vector<bool>& vis) const {
-    if (!vis[_id]) {
-        cout << typeString() << " " << _id << endl;
-    } else if (type() == GATE_PI || cur == depth) {
-        cout << typeString() << " " << _id << endl;
-        return true;
-    } else {
-        cout << typeString() << " " << _id << " (*)" << endl;
-        return true;
-    }
-
-    if (vis[_id]) return true;
-    if (cur == depth) return true;
-
-    string indent;
-    for (int i = 0; i <= cur; i++)
-        indent += "  ";
-
-    bool done = true;
-    for (int i = 0; i < _LFanIn.size(); i++) {
-        cout << indent;
-        if (_LFanIn[i] & 1) cout << "!";
+    GateType last = fanout ? GATE_PO : GATE_PI;
+    auto enter = [&](const CirGate* g) {
+        int cur = stack.size();
+        cout << g->typeString() << " " << g->id();
+        if (vis[g->id()] && g->type() != last && cur != depth) cout << " (*)";
+        cout << endl;
+        if (!vis[g->id()] && cur != depth) stack.push_back({g, 0});
+    };
+
+    enter(root);
+    while (!stack.empty()) {
+        Frame& f = stack.back();
+        int n = fanout ? f.gate->fanOutSize() : f.gate->fanInSize();
+        if (f.i == n) {
+            vis[f.gate->id()] = true;
+            stack.pop_back();
+            continue;
+        }
+        int lid = fanout ? f.gate->fanOut(f.i++) : f.gate->fanIn(f.i++);
+        cout << string(2 * stack.size(), ' ');
+        if (lid & 1) cout << "!";
 
-        CirGate* gate = cirMgr->getGateByLID(_LFanIn[i]);
+        CirGate* gate = cirMgr->getGateByLID(lid);
         if (gate)
-            done &= gate->reportFanin(depth, cur + 1, vis);
+            enter(gate);
         else
-            cout << "UNDEF " << _LFanIn[i] / 2 << endl;
+            cout << "UNDEF " << lid / 2 << endl;
     }
-    if (done) vis[_id] = true;
-    return done;
 }
-void CirGate::reportFanout(int level) const {
+
+void CirGate::reportFanin(int level) const {
     assert(level >= 0);
-    vector<bool> vis(cirMgr->size() + 1, false);
-    reportFanout(level, 0, vis);
+    reportCone(this, level, false);
 }
-bool CirGate::reportFanout(int depth, int cur, vector<bool>& vis) const {
-    if (!vis[_id]) {
-        cout << typeString() << " " << _id << endl;
-    } else if (type() == GATE_PO || cur == depth) {
-        cout << typeString() << " " << _id << endl;
-        return true;
-    } else {
-        cout << typeString() << " " << _id << " (*)" << endl;
-        return true;
-    }
-
-    if (vis[_id]) return true;
-    if (cur == depth) return true;
-
-    string indent;
-    for (int i = 0; i <= cur; i++)
-        indent += "  ";
-
-    bool done = true;
-    for (int i = 0; i < _LFanOut.size(); i++) {
-        cout << indent;
-        if (_LFanOut[i] & 1) cout << "!";
-
-        CirGate* gate = cirMgr->getGateByLID(_LFanOut[i]);
-        if (gate)
-            done &= gate->reportFanout(depth, cur + 1, vis);
-        else
-            cout << "UNDEF " << _LFanOut[i] / 2 << endl;
-    }
-    if (done) vis[_id] = true;
-    return done;
+void CirGate::reportFanout(int level) const {
+    assert(level >= 0);
+    reportCone(this, level, true);
 }
-void CirAIG::printGate() const {
-    cout << "AIG " << _id << " ";
-    cout << (cirMgr->getGateByLID(_LFanIn[0]) == NULL ? "*" : "")
-         << (_LFanIn[0] % 2 ? "!" : "") << _LFanIn[0] / 2 << " ";
-    cout << (cirMgr->getGateByLID(_LFanIn[1]) == NULL ? "*" : "")
-         << (_LFanIn[1] % 2 ? "!" : "") << _LFanIn[1] / 2;
-    if (hasSymbol()) cout << " (" << _symbol << ")";
+void CirAIG::printGate(BufWriter& out) const {
+    int lid0 = fanIn(0), lid1 = fanIn(1);
+    out << "AIG " << _id << " ";
+    out << (cirMgr->getGateByLID(lid0) == NULL ? "*" : "")
+        << (lid0 % 2 ? "!" : "") << lid0 / 2 << " ";
+    out << (cirMgr->getGateByLID(lid1) == NULL ? "*" : "")
+        << (lid1 % 2 ? "!" : "") << lid1 / 2;
+    if (hasSymbol()) out << " (" << symbol() << ")";
 }
-void CirPO::printGate() const {
-    cout << "PO  " << _id << " ";
-    cout << (cirMgr->getGateByLID(_LFanIn[0]) == NULL ? "*" : "")
-         << (_LFanIn[0] % 2 ? "!" : "") << _LFanIn[0] / 2;
-    if (hasSymbol()) cout << " (" << _symbol << ")";
+void CirPO::printGate(BufWriter& out) const {
+    int lid0 = fanIn(0);
+    out << "PO  " << _id << " ";
+    out << (cirMgr->getGateByLID(lid0) == NULL ? "*" : "")
+        << (lid0 % 2 ? "!" : "") << lid0 / 2;
+    if (hasSymbol()) out << " (" << symbol() << ")";
 }
-void CirPI::printGate() const {
-    cout << "PI  " << _id;
-    if (hasSymbol()) cout << " (" << _symbol << ")";
+void CirPI::printGate(BufWriter& out) const {
+    out << "PI  " << _id;
+    if (hasSymbol()) out << " (" << symbol() << ")";
 }
-void Cir0::printGate() const { cout << "CONST0"; }
\ No newline at end of file
+void Cir0::printGate(BufWriter& out) const { out << "CONST0"; }
\ No newline at end of file
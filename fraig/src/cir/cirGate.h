@@ -9,11 +9,13 @@
 #ifndef CIR_GATE_H
 #define CIR_GATE_H
 
+#include <bitset>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <list>
 #include "cirDef.h"
+#include "myWriter.h"
 #include "sat.h"
 
 using namespace std;
@@ -27,18 +29,20 @@ class CirGate;
 //------------------------------------------------------------------------
 class CirGate {
    public:
-    CirGate(int id) : _simVal(32), _id(id) {}
+    CirGate(int id) : _id(id) {}
     virtual ~CirGate() {}
 
     // Basic access methods
     int id() const { return _id; }
     int lineNo() const { return _lineNo; }
-    const string& symbol() const { return _symbol; }
+    const char* symbol() const;
     virtual GateType type() const = 0;
     virtual string typeString() const = 0;
 
-    GateList& LFanIn() { return _LFanIn; }
-    GateList& LFanOut() { return _LFanOut; }
+    int fanInSize() const;
+    int fanIn(int i) const;
+    int fanOutSize() const;
+    int fanOut(int i) const;
 
     virtual bool isAig() const { return false; }
 
@@ -46,29 +50,19 @@ class CirGate {
     void reportGate() const;
     void reportFanin(int level) const;
     void reportFanout(int level) const;
-    virtual void printGate() const = 0;
+    virtual void printGate(BufWriter &) const = 0;
 
     void setLineNo(int line) { _lineNo = line; }
-    void setSymbol(const string& s) { _symbol = s; }
-    bool hasSymbol() const { return !_symbol.empty(); }
-
-    void addFanIn(int lid) { _LFanIn.push_back(lid); }
-    void addFanOut(int lid) { _LFanOut.push_back(lid); }
+    bool hasSymbol() const { return *symbol() != 0; }
 
     list<list<int>>::iterator _FECGroupIt;
     bool _FECInv;
-    vector<bool> _simVal;
+    bitset<32> _simVal;
 
    private:
    protected:
-    GateList _LFanIn;
-    GateList _LFanOut;
-    string _symbol;
     int _id;
     int _lineNo;
-
-    bool reportFanin(int depth, int cur, vector<bool>& vis) const;
-    bool reportFanout(int depth, int cur, vector<bool>& vis) const;
 };
 
 #endif  // CIR_GATE_H
@@ -80,7 +74,7 @@ class CirAIG : public CirGate {
     virtual GateType type() const { return GATE_AIG; }
     virtual string typeString() const { return "AIG"; }
     virtual bool isAig() const { return true; }
-    virtual void printGate() const;
+    virtual void printGate(BufWriter &) const;
 
    private:
 };
@@ -91,7 +85,7 @@ class CirPO : public CirGate {
     virtual ~CirPO() {}
     virtual GateType type() const { return GATE_PO; }
     virtual string typeString() const { return "PO"; }
-    virtual void printGate() const;
+    virtual void printGate(BufWriter &) const;
 
    private:
 };
@@ -102,7 +96,7 @@ class CirPI : public CirGate {
     virtual ~CirPI() {}
     virtual GateType type() const { return GATE_PI; }
     virtual string typeString() const { return "PI"; }
-    virtual void printGate() const;
+    virtual void printGate(BufWriter &) const;
 
    private:
 };
@@ -113,7 +107,7 @@ class Cir0 : public CirGate {
     virtual ~Cir0() {}
     virtual GateType type() const { return GATE_CONST0; }
     virtual string typeString() const { return "CONST0"; }
-    virtual void printGate() const;
+    virtual void printGate(BufWriter &) const;
 
    private:
 };
@@ -0,0 +1,358 @@
+/****************************************************************************
+  FileName     [ cirImage.cpp ]
+  PackageName  [ cir ]
+  Synopsis     [ Define cir snapshot image save/load functions ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2008-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "cirGate.h"
+#include "cirMgr.h"
+#include "util.h"
+
+using namespace std;
+
+// Keep "CirMgr::saveImage()" and "CirMgr::loadImage()" for cir cmd.
+// An image is a header followed by flat, 8-byte aligned arrays, so loading
+// is one mmap plus bulk copies; no text is parsed and no analysis is rerun.
+
+/*******************************/
+/*   Global variable and enum  */
+/*******************************/
+enum ImageSection {
+    IMG_GATE,
+    IMG_FANIN_OFS,
+    IMG_FANIN,
+    IMG_FANOUT_OFS,
+    IMG_FANOUT,
+    IMG_SYMBOL_OFS,
+    IMG_SYMBOL,
+    IMG_PI,
+    IMG_PO,
+    IMG_AIG,
+    IMG_FEC_OFS,
+    IMG_FEC,
+
+    IMG_SECTION_TOT
+};
+
+/**************************************/
+/*   Static varaibles and functions   */
+/**************************************/
+static const char imageMagic[8] = "CIRIMG";
+static const uint32_t imageVersion = 1;
+
+struct ImageHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t stage;
+    uint64_t srcHash;
+    int32_t M, I, L, O, A;
+    int32_t nGates;
+    uint64_t offset[IMG_SECTION_TOT];
+    uint64_t bytes[IMG_SECTION_TOT];
+};
+
+struct ImageGate {
+    uint8_t type;
+    uint8_t active;
+    uint8_t pad[2];
+    int32_t lineNo;
+    uint32_t simVal;
+};
+
+// 64-bit FNV-1a over the whole file; 0 if the file cannot be mapped
+static uint64_t hashFile(const string& fileName) {
+    int fd = open(fileName.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0) return 0;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    void* map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+
+    uint64_t h = 14695981039346656037ULL;
+    const unsigned char* p = (const unsigned char*)map;
+    for (off_t i = 0; i < st.st_size; ++i)
+        h = (h ^ p[i]) * 1099511628211ULL;
+    munmap(map, st.st_size);
+    return h;
+}
+
+class ImageWriter {
+   public:
+    ImageWriter(ofstream& os, ImageHeader& h) : _os(os), _h(h), _pos(0) {
+        write(&h, sizeof(h));
+    }
+    template <class T>
+    void section(ImageSection s, const vector<T>& v) {
+        static const char zero[8] = {0};
+        write(zero, (8 - _pos % 8) % 8);
+        _h.offset[s] = _pos;
+        _h.bytes[s] = v.size() * sizeof(T);
+        write(v.data(), _h.bytes[s]);
+    }
+
+   private:
+    void write(const void* p, size_t n) {
+        _os.write((const char*)p, n);
+        _pos += n;
+    }
+    ofstream& _os;
+    ImageHeader& _h;
+    uint64_t _pos;
+};
+
+template <class T>
+static const T* imageSection(const char* img, const ImageHeader& h,
+                             ImageSection s, size_t& n) {
+    n = h.bytes[s] / sizeof(T);
+    return (const T*)(img + h.offset[s]);
+}
+
+// ofs[0 .. n] must climb from 0 to size
+static bool checkOffsets(const int* ofs, size_t n, size_t size) {
+    if (ofs[0] != 0 || ofs[n] < 0 || (size_t)ofs[n] != size) return false;
+    for (size_t i = 0; i < n; ++i)
+        if (ofs[i] > ofs[i + 1]) return false;
+    return true;
+}
+
+// lits[0 .. n) must be literals of the image; with built set they must also
+// name gates that exist, and with type set gates of exactly that type
+static bool checkLits(const int* lits, size_t n, const ImageGate* gates,
+                      int nGates, bool built, int type = -1) {
+    for (size_t i = 0; i < n; ++i) {
+        if (lits[i] < 0 || lits[i] / 2 >= nGates) return false;
+        int t = gates[lits[i] / 2].type;
+        if (built && t >= GATE_UNDEF) return false;
+        if (type >= 0 && t != type) return false;
+    }
+    return true;
+}
+
+// Everything loadImage() reads must lie inside the mapping and index only
+// gates of the image, so that a bad image is refused before reset().
+static bool checkImage(const char* img, size_t len, const ImageHeader& h) {
+    static const size_t unit[IMG_SECTION_TOT] = {
+        sizeof(ImageGate), sizeof(int), sizeof(int), sizeof(int),
+        sizeof(int),       sizeof(int), sizeof(char), sizeof(int),
+        sizeof(int),       sizeof(int), sizeof(int),  sizeof(int)};
+    if (h.nGates < 1) return false;
+    for (int s = 0; s < IMG_SECTION_TOT; ++s)
+        if (h.offset[s] % 8 != 0 || h.offset[s] > len ||
+            h.bytes[s] > len - h.offset[s] || h.bytes[s] % unit[s] != 0)
+            return false;
+
+    size_t n = h.nGates, nGate, nFanin, nFanout, nSymbol, nLits, nFEC;
+    size_t nOfs[3];
+    const ImageGate* gates = imageSection<ImageGate>(img, h, IMG_GATE, nGate);
+    const int* faninOfs = imageSection<int>(img, h, IMG_FANIN_OFS, nOfs[0]);
+    const int* fanin = imageSection<int>(img, h, IMG_FANIN, nFanin);
+    const int* fanoutOfs = imageSection<int>(img, h, IMG_FANOUT_OFS, nOfs[1]);
+    const int* fanout = imageSection<int>(img, h, IMG_FANOUT, nFanout);
+    const int* symbolOfs = imageSection<int>(img, h, IMG_SYMBOL_OFS, nOfs[2]);
+    imageSection<char>(img, h, IMG_SYMBOL, nSymbol);
+    if (nGate != n || nOfs[0] != n + 1 || nOfs[1] != n + 1 ||
+        nOfs[2] != n + 1)
+        return false;
+    if (!checkOffsets(faninOfs, n, nFanin) ||
+        !checkOffsets(fanoutOfs, n, nFanout) ||
+        !checkOffsets(symbolOfs, n, nSymbol))
+        return false;
+    for (size_t id = 0; id < n; ++id) {
+        int t = gates[id].type;
+        int nIn = t == GATE_AIG ? 2 : t == GATE_PO ? 1 : 0;
+        if (t > GATE_UNDEF || faninOfs[id + 1] - faninOfs[id] != nIn)
+            return false;
+    }
+    // fanins and POs may float on undefined gates; the rest are built
+    if (!checkLits(fanin, nFanin, gates, n, false) ||
+        !checkLits(fanout, nFanout, gates, n, true))
+        return false;
+    const int* lits = imageSection<int>(img, h, IMG_PI, nLits);
+    if (!checkLits(lits, nLits, gates, n, true, GATE_PI)) return false;
+    lits = imageSection<int>(img, h, IMG_PO, nLits);
+    if (!checkLits(lits, nLits, gates, n, false)) return false;
+    lits = imageSection<int>(img, h, IMG_AIG, nLits);
+    if (!checkLits(lits, nLits, gates, n, true, GATE_AIG)) return false;
+
+    const int* fecOfs = imageSection<int>(img, h, IMG_FEC_OFS, nLits);
+    const int* fec = imageSection<int>(img, h, IMG_FEC, nFEC);
+    return nLits >= 1 && checkOffsets(fecOfs, nLits - 1, nFEC) &&
+           checkLits(fec, nFEC, gates, n, true);
+}
+
+/*******************************************/
+/*   Public member functions about image   */
+/*******************************************/
+bool CirMgr::saveImage(const string& fileName, int stage) const {
+    ofstream os(fileName.c_str(), ios::out | ios::binary);
+    if (!os) {
+        cerr << "Cannot open image \"" << fileName << "\"!!" << endl;
+        return false;
+    }
+
+    ImageHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, imageMagic, sizeof(h.magic));
+    h.version = imageVersion;
+    h.stage = stage;
+    h.srcHash = _srcFile.empty() ? _srcHash : hashFile(_srcFile);
+    h.M = _MaxIndex, h.I = _InputNum, h.L = _LatchNum;
+    h.O = _OutputNum, h.A = _AIGNum;
+    h.nGates = _gates.size();
+
+    vector<ImageGate> gates(_gates.size());
+    vector<int> faninOfs(1, 0), fanin, fanoutOfs(1, 0), fanout;
+    vector<int> symbolOfs(1, 0);
+    vector<char> symbol;
+    for (int id = 0; id < _gates.size(); ++id) {
+        CirGate* gate = _gates[id];
+        ImageGate& g = gates[id];
+        memset(&g, 0, sizeof(g));
+        g.type = gate ? gate->type() : GATE_UNDEF;
+        g.active = _active[id];
+        if (gate) {
+            g.lineNo = gate->lineNo();
+            for (int i = 0; i < 32; ++i)
+                if (gate->_simVal[i]) g.simVal |= 1u << i;
+            for (int i = 0; i < fanInSize(id); i++)
+                fanin.push_back(fanIn(id, i));
+            for (int i = 0; i < fanOutSize(id); i++)
+                fanout.push_back(fanOut(id, i));
+            const char* name = getSymbol(id);
+            symbol.insert(symbol.end(), name, name + strlen(name));
+        }
+        faninOfs.push_back(fanin.size());
+        fanoutOfs.push_back(fanout.size());
+        symbolOfs.push_back(symbol.size());
+    }
+    vector<int> fecOfs(1, 0), fec;
+    for (auto& FECGroup : _FECGroupList) {
+        fec.insert(fec.end(), FECGroup.begin(), FECGroup.end());
+        fecOfs.push_back(fec.size());
+    }
+
+    ImageWriter w(os, h);
+    w.section(IMG_GATE, gates);
+    w.section(IMG_FANIN_OFS, faninOfs);
+    w.section(IMG_FANIN, fanin);
+    w.section(IMG_FANOUT_OFS, fanoutOfs);
+    w.section(IMG_FANOUT, fanout);
+    w.section(IMG_SYMBOL_OFS, symbolOfs);
+    w.section(IMG_SYMBOL, symbol);
+    w.section(IMG_PI, _LInputs);
+    w.section(IMG_PO, _LOutputs);
+    w.section(IMG_AIG, _LAIGs);
+    w.section(IMG_FEC_OFS, fecOfs);
+    w.section(IMG_FEC, fec);
+    os.seekp(0);
+    os.write((const char*)&h, sizeof(h));
+    return (bool)os;
+}
+
+// srcFile (optional) must hash to the key stored in the image
+bool CirMgr::loadImage(const string& fileName, const string& srcFile,
+                       int& stage) {
+    int fd = open(fileName.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) close(fd);
+        cerr << "Cannot open image \"" << fileName << "\"!!" << endl;
+        return false;
+    }
+    size_t len = st.st_size;
+    void* map = len ? mmap(0, len, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+        cerr << "Cannot open image \"" << fileName << "\"!!" << endl;
+        return false;
+    }
+
+    const char* img = (const char*)map;
+    ImageHeader h;
+    bool ok = len >= sizeof(h);
+    if (ok) memcpy(&h, img, sizeof(h));
+    ok = ok && memcmp(h.magic, imageMagic, sizeof(h.magic)) == 0 &&
+         h.version == imageVersion && h.nGates == h.M + h.O + 1 &&
+         checkImage(img, len, h);
+    if (!ok) {
+        munmap(map, len);
+        cerr << "Error: \"" << fileName << "\" is not a valid circuit image "
+             << "(version " << imageVersion << ")!!" << endl;
+        return false;
+    }
+    if (!srcFile.empty() && hashFile(srcFile) != h.srcHash) {
+        munmap(map, len);
+        cerr << "Error: image \"" << fileName << "\" is stale for \"" << srcFile
+             << "\"!!" << endl;
+        return false;
+    }
+
+    reset();
+    _srcFile = srcFile;
+    _srcHash = h.srcHash;
+    setHeader(h.M, h.I, h.L, h.O, h.A);
+    stage = h.stage;
+
+    size_t n;
+    const ImageGate* gates = imageSection<ImageGate>(img, h, IMG_GATE, n);
+    const int* faninOfs = imageSection<int>(img, h, IMG_FANIN_OFS, n);
+    const int* fanin = imageSection<int>(img, h, IMG_FANIN, n);
+    const int* fanoutOfs = imageSection<int>(img, h, IMG_FANOUT_OFS, n);
+    const int* fanout = imageSection<int>(img, h, IMG_FANOUT, n);
+    const int* symbolOfs = imageSection<int>(img, h, IMG_SYMBOL_OFS, n);
+    const char* symbol = imageSection<char>(img, h, IMG_SYMBOL, n);
+    for (int id = 0; id < h.nGates; ++id) {
+        const ImageGate& g = gates[id];
+        CirGate* gate = createGate(GateType(g.type), id);
+        _active[id] = g.active;
+        if (!gate) continue;
+        gate->setLineNo(g.lineNo);
+        for (int i = 0; i < 32; ++i)
+            gate->_simVal[i] = (g.simVal >> i) & 1;
+        const int* in = fanin + faninOfs[id];
+        int nIn = faninOfs[id + 1] - faninOfs[id];
+        setFanIn(id, nIn > 0 ? in[0] : -1, nIn > 1 ? in[1] : -1);
+        if (symbolOfs[id] != symbolOfs[id + 1])
+            setSymbol(id, string(symbol + symbolOfs[id],
+                                 symbol + symbolOfs[id + 1]));
+    }
+    GateList count(h.nGates);
+    for (int id = 0; id < h.nGates; ++id)
+        count[id] = fanoutOfs[id + 1] - fanoutOfs[id];
+    initFanOut(count);
+    _foSize = count;
+    _foLits.assign(fanout, fanout + fanoutOfs[h.nGates]);
+    for (int id = 0; id < h.nGates; ++id) indexFanOut(id);
+
+    const int* lits = imageSection<int>(img, h, IMG_PI, n);
+    _LInputs.assign(lits, lits + n);
+    lits = imageSection<int>(img, h, IMG_PO, n);
+    _LOutputs.assign(lits, lits + n);
+    lits = imageSection<int>(img, h, IMG_AIG, n);
+    _LAIGs.assign(lits, lits + n);
+    countRefs();
+
+    const int* fecOfs = imageSection<int>(img, h, IMG_FEC_OFS, n);
+    const int* fec = imageSection<int>(img, h, IMG_FEC, n);
+    _FECGroupList.clear();
+    for (size_t i = 0; i + 1 < h.bytes[IMG_FEC_OFS] / sizeof(int); ++i)
+        _FECGroupList.push_back(list<int>(fec + fecOfs[i], fec + fecOfs[i + 1]));
+    // gates in no group get the empty one, as after a simulation
+    linkFECGroups();
+    munmap(map, len);
+    return true;
+}
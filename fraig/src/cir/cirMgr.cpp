@@ -8,7 +8,13 @@
 
 #include "cirMgr.h"
 #include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cassert>
 #include <cstdio>
 #include <cstring>
@@ -17,6 +23,11 @@
 #include <sstream>
 #include <string>
 #include "cirGate.h"
+#include "cirPack.h"
+#include "memMgr.h"
+#include "myThreadPool.h"
+#include "myWriter.h"
+#include "myZStream.h"
 #include "util.h"
 
 using namespace std;
@@ -27,6 +38,7 @@ using namespace std;
 /*   Global variable and enum  */
 /*******************************/
 CirMgr* cirMgr = 0;
+list<list<int>> CirMgr::_noFECGroup(1);
 
 enum CirParseError {
     EXTRA_SPACE,
@@ -149,14 +161,33 @@ static bool parseError(CirParseError err) {
 /**************************************************************/
 /*   class CirMgr member functions for circuit construction   */
 /**************************************************************/
-bool CirMgr::readCircuit(const string& fileName) {
-    ifstream aigerFile(fileName.c_str());
+bool CirMgr::readCircuit(const string& fileName, int mode, int nThreads) {
+    reset();
+    _srcFile = fileName;
+    if (mode & READ_LAZY_SYMBOL) _symFile = fileName;
+    _strashOnRead = mode & (READ_STRASH | READ_PIPELINE);
+    _pipeOnRead = mode & READ_PIPELINE;
+    if (ZInBuf::isCompressed(fileName))
+        return readCompressed(fileName, mode, nThreads);
+
+    ifstream aigerFile(fileName.c_str(), ios::in | ios::binary);
     if (!aigerFile.is_open()) {
         cout << "Cannot open design \"" << fileName << "\"!!" << endl;
         return false;
     }
-    reset();
 
+    char magic[4] = {0};
+    aigerFile.read(magic, 3);
+    aigerFile.seekg(0);
+    if (strcmp(magic, "aig") == 0) return readAig(aigerFile);
+    if ((mode & READ_MMAP) || nThreads > 1) {
+        aigerFile.close();
+        return readAagMmap(fileName, nThreads);
+    }
+    return readAag(aigerFile);
+}
+
+bool CirMgr::readAag(istream& aigerFile) {
     string buf;
     int bufInt;
     vector<int> params;
@@ -173,21 +204,14 @@ bool CirMgr::readCircuit(const string& fileName) {
             while (ss >> bufInt)
                 params.push_back(bufInt);
             setHeader(params[0], params[1], params[2], params[3], params[4]);
-            _gates[0] = new Cir0(0);
+            createGate(GATE_CONST0, 0);
             _active[0] = true;
         } else if (buf[0] == 'c') {
             break;
-        } else if (buf[0] == 'i') {
-            buf[0] = ' ';
-            ss << buf, ss >> bufInt >> buf;
-            int id = toID(_LInputs[bufInt]);
-            _gates[id]->setSymbol(buf);
-        } else if (buf[0] == 'o') {
-            buf[0] = ' ';
-            ss << buf, ss >> bufInt >> buf;
-            int id = toID(_LOutputs[bufInt]);
-            _gates[id]->setSymbol(buf);
-            _active[id] = true;
+        } else if (buf[0] == 'i' || buf[0] == 'o') {
+            if (deferSymbols((size_t)aigerFile.tellg() - buf.size() - 1))
+                break;
+            readSymbol(buf);
         } else if (isdigit(buf[0])) {
             ss << buf;
             while (ss >> bufInt)
@@ -196,7 +220,7 @@ bool CirMgr::readCircuit(const string& fileName) {
                 if (_LInputs.size() < _InputNum) {
                     _LInputs.push_back(params[0]);
                     int id = toID(params[0]);
-                    _gates[id] = new CirPI(id);
+                    createGate(GATE_PI, id);
 
                     _active[id] = true;
                     _gates[id]->setLineNo(line);
@@ -205,57 +229,810 @@ bool CirMgr::readCircuit(const string& fileName) {
                     linePO.push_back(line);
                 }
             } else if (params.size() == 3) {
-                _LAIGs.push_back(params[0]);
-                int id = toID(params[0]);
-                _gates[id] = new CirAIG(id);
-                _active[id] = true;
-
-                _gates[id]->addFanIn(params[1]);
-                _gates[id]->addFanIn(params[2]);
-                _gates[id]->setLineNo(line);
+                addAIG(params[0], params[1], params[2], line);
             } else {
             }
         } else {
         }
     }
 
+    buildConnection(linePO);
+    sort(_LAIGs.begin(), _LAIGs.end());
+    return true;
+}
+
+// .gz/.zst inputs are inflated on the fly. A compressed file cannot be
+// mapped, so -Mmap/-Threads inflate it once into memory and scan that.
+bool CirMgr::readCompressed(const string& fileName, int mode, int nThreads) {
+    ZInStream aigerFile(fileName);
+    if (!aigerFile.is_open()) {
+        cout << "Cannot open design \"" << fileName << "\"!!" << endl;
+        return false;
+    }
+
+    char magic[4] = {0};
+    aigerFile.peekBytes(magic, 3);
+    if (strcmp(magic, "aig") == 0) return readAig(aigerFile);
+    if ((mode & READ_MMAP) || nThreads > 1) {
+        string buf;
+        aigerFile.readAll(buf);
+        ThreadPool pool(nThreads > 1 ? nThreads : 1);
+        return parseAag(buf.data(), buf.data() + buf.size(), &pool);
+    }
+    return readAag(aigerFile);
+}
+
+// Binary AIGER: inputs are implicit (literals 2, 4, ..., 2I), outputs are
+// ASCII lines, and each AND is two varint deltas (lhs - rhs0, rhs0 - rhs1)
+// with lhs = 2 * (I + L + i + 1). Line numbers follow the equivalent .aag.
+static bool decodeDelta(streambuf* sb, unsigned& delta) {
+    delta = 0;
+    for (unsigned shift = 0; shift < 32; shift += 7) {
+        int ch = sb->sbumpc();
+        if (ch == EOF) return false;
+        delta |= (unsigned)(ch & 0x7f) << shift;
+        if (!(ch & 0x80)) return true;
+    }
+    return false;
+}
+
+bool CirMgr::readAig(istream& aigerFile) {
+    string buf;
+    stringstream ss;
+    int M, I, L, O, A;
+
+    lineNo = 0;
+    getline(aigerFile, buf);
+    ss << buf, ss >> buf >> M >> I >> L >> O >> A;
+    if (!ss || M < I + L + A) {
+        errMsg = "binary AIGER header";
+        return parseError(ILLEGAL_NUM);
+    }
+    setHeader(M, I, L, O, A);
+    createGate(GATE_CONST0, 0);
+    _active[0] = true;
+
+    int line = 1;
+    for (int id = 1; id <= I; ++id) {
+        _LInputs.push_back(toLID(id));
+        createGate(GATE_PI, id);
+        _active[id] = true;
+        _gates[id]->setLineNo(++line);
+    }
+    // latches are not supported by this package; skip their lines
+    for (int i = 0; i < L; ++i, ++line)
+        getline(aigerFile, buf);
+
+    vector<int> linePO;
+    for (int i = 0; i < O; ++i) {
+        getline(aigerFile, buf);
+        _LOutputs.push_back(atoi(buf.c_str()));
+        linePO.push_back(++line);
+    }
+
+    streambuf* sb = aigerFile.rdbuf();
+    _LAIGs.reserve(A);
+    for (int i = 0, id = I + L + 1; i < A; ++i, ++id) {
+        unsigned delta0, delta1;
+        lineNo = line++;
+        if (!decodeDelta(sb, delta0) || !decodeDelta(sb, delta1)) {
+            errMsg = "AIG";
+            return parseError(MISSING_DEF);
+        }
+        int lid0 = toLID(id) - (int)delta0;
+        int lid1 = lid0 - (int)delta1;
+        if (delta0 == 0 || lid0 < 0 || lid1 < 0) {
+            errMsg = "binary AIG delta";
+            return parseError(ILLEGAL_NUM);
+        }
+        addAIG(toLID(id), lid0, lid1, line);
+    }
+
+    // symbol table and comments are plain text, same as in ASCII AIGER
+    if (deferSymbols(aigerFile.tellg())) {
+        buildConnection(linePO);
+        return true;
+    }
+    while (getline(aigerFile, buf)) {
+        if (buf.empty()) continue;
+        if (buf[0] == 'c') break;
+        if (buf[0] == 'i' || buf[0] == 'o') readSymbol(buf);
+    }
+
+    buildConnection(linePO);
+    return true;
+}
+
+void CirMgr::readSymbol(string& buf) {
+    stringstream ss;
+    int bufInt;
+    char type = buf[0];
+
+    buf[0] = ' ';
+    ss << buf, ss >> bufInt >> buf;
+    setIOSymbol(type, bufInt, buf);
+}
+
+// Output names are kept on the PO gate (id _MaxIndex + 1 + idx), so this
+// works both while parsing and when the table is loaded lazily later.
+void CirMgr::setIOSymbol(char type, int idx, const string& name) const {
+    if (type == 'o' && idx < _OutputNum)
+        setSymbol(_MaxIndex + 1 + idx, name);
+    else if (type == 'i' && idx < _LInputs.size())
+        setSymbol(toID(_LInputs[idx]), name);
+}
+
+// All names live in one NUL-separated arena; _symOfs[id] is the offset of
+// gate id's name or -1. With READ_LAZY_SYMBOL the parser only records where
+// the symbol table starts and it is read on the first lookup.
+void CirMgr::setSymbol(int id, const string& name) const {
+    _symOfs[id] = _symArena.size();
+    _symArena.insert(_symArena.end(), name.begin(), name.end());
+    _symArena.push_back(0);
+}
+
+const char* CirMgr::getSymbol(int id) const {
+    if (!_symFile.empty()) loadSymbols();
+    return _symOfs[id] < 0 ? "" : &_symArena[_symOfs[id]];
+}
+
+bool CirMgr::deferSymbols(size_t pos) {
+    if (_symFile.empty()) return false;
+    _symPos = pos;
+    return true;
+}
+
+void CirMgr::loadSymbols() const {
+    string fileName = _symFile;
+    _symFile.clear();
+    if (_symPos == string::npos) return;
+
+    ifstream plainFile;
+    ZInStream zipFile;
+    istream* in = &plainFile;
+    if (ZInBuf::isCompressed(fileName)) {
+        zipFile.open(fileName);
+        zipFile.ignore(_symPos);
+        in = &zipFile;
+    } else {
+        plainFile.open(fileName.c_str(), ios::in | ios::binary);
+        plainFile.seekg(_symPos);
+    }
+
+    string buf;
+    while (getline(*in, buf)) {
+        if (buf.empty()) continue;
+        if (buf[0] == 'c') break;
+        if (buf[0] != 'i' && buf[0] != 'o') continue;
+        char type = buf[0];
+        int idx = atoi(buf.c_str() + 1);
+        size_t b = buf.find(' ');
+        if (b == string::npos) continue;
+        b = buf.find_first_not_of(" \t", b);
+        if (b == string::npos) continue;
+        size_t e = buf.find_first_of(" \t\r", b);
+        setIOSymbol(type, idx, buf.substr(b, e == string::npos ? e : e - b));
+    }
+}
+
+/**************************************/
+/*   mmap-based ASCII AIGER scanner   */
+/**************************************/
+// Scans the mapped file in place: no per-line string, stringstream or
+// parameter vector. Only the symbol names are copied out.
+class AagScanner {
+   public:
+    AagScanner(const char* begin, const char* end)
+        : _p(begin), _end(end), _line(1) {}
+
+    bool eof() const { return _p >= _end; }
+    char peek() const { return eof() ? 0 : *_p; }
+    int line() const { return _line; }
+    const char* pos() const { return _p; }
+    void skip() { ++_p; }
+    void seek(const char* p, int line) { _p = p, _line = line; }
+
+    bool readInt(int& n) {
+        while (_p < _end && (*_p == ' ' || *_p == '\t' || *_p == '\r')) ++_p;
+        if (_p >= _end || !isdigit(*_p)) return false;
+        unsigned v = 0;
+        do {
+            v = v * 10 + (*_p++ - '0');
+        } while (_p < _end && isdigit(*_p));
+        n = (int)v;
+        return true;
+    }
+    bool readWord(string& w) {
+        while (_p < _end && (*_p == ' ' || *_p == '\t')) ++_p;
+        const char* b = _p;
+        while (_p < _end && !isspace(*_p)) ++_p;
+        w.assign(b, _p);
+        return _p != b;
+    }
+    bool expect(const char* s) {
+        for (; *s; ++s, ++_p)
+            if (_p >= _end || *_p != *s) return false;
+        return true;
+    }
+    void nextLine() {
+        const char* nl = (const char*)memchr(_p, '\n', _end - _p);
+        _p = nl ? nl + 1 : _end;
+        ++_line;
+    }
+
+   private:
+    const char* _p;
+    const char* _end;
+    int _line;
+};
+
+bool CirMgr::readAagMmap(const string& fileName, int nThreads) {
+    int fd = open(fileName.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        if (fd >= 0) close(fd);
+        cerr << "Cannot map design \"" << fileName << "\"!!" << endl;
+        return false;
+    }
+    size_t len = st.st_size;
+    void* map = mmap(0, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        cerr << "Cannot map design \"" << fileName << "\"!!" << endl;
+        return false;
+    }
+    madvise(map, len, MADV_SEQUENTIAL);
+
+    auto start = chrono::steady_clock::now();
+    const char* begin = (const char*)map;
+    ThreadPool pool(nThreads > 1 ? nThreads : 1);
+    bool ok = parseAag(begin, begin + len, &pool);
+    double sec = chrono::duration<double>(chrono::steady_clock::now() - start)
+                     .count();
+    munmap(map, len);
+
+    if (ok) {
+        double mb = len / 1048576.0;
+        printf("Parsed %.2f MB in %.3f s (%.2f MB/s)\n", mb, sec,
+               sec > 0 ? mb / sec : 0.0);
+    }
+    return ok;
+}
+
+bool CirMgr::parseAag(const char* begin, const char* end, ThreadPool* pool) {
+    AagScanner sc(begin, end);
+    int M, I, L, O, A, lid;
+
+    lineNo = 0;
+    if (!sc.expect("aag") || !sc.readInt(M) || !sc.readInt(I) ||
+        !sc.readInt(L) || !sc.readInt(O) || !sc.readInt(A)) {
+        errMsg = "aag header";
+        return parseError(ILLEGAL_NUM);
+    }
+    sc.nextLine();
+    setHeader(M, I, L, O, A);
+    createGate(GATE_CONST0, 0);
+    _active[0] = true;
+
+    _LInputs.reserve(I);
+    for (int i = 0; i < I; ++i, sc.nextLine()) {
+        lineNo = sc.line() - 1;
+        if (!sc.readInt(lid)) {
+            errMsg = "PI literal";
+            return parseError(MISSING_NUM);
+        }
+        if (toID(lid) > _MaxIndex) {
+            errInt = lid;
+            return parseError(MAX_LIT_ID);
+        }
+        int id = toID(lid);
+        _LInputs.push_back(lid);
+        createGate(GATE_PI, id);
+        _active[id] = true;
+        _gates[id]->setLineNo(sc.line());
+    }
+    for (int i = 0; i < L; ++i)
+        sc.nextLine();
+
+    vector<int> linePO;
+    _LOutputs.reserve(O);
+    linePO.reserve(O);
+    for (int i = 0; i < O; ++i, sc.nextLine()) {
+        lineNo = sc.line() - 1;
+        if (!sc.readInt(lid)) {
+            errMsg = "PO literal";
+            return parseError(MISSING_NUM);
+        }
+        _LOutputs.push_back(lid);
+        linePO.push_back(sc.line());
+    }
+
+    int i = 0;
+    _LAIGs.reserve(A);
+    if (pool && pool->size() > 1 && A > 0) {
+        const char* andEnd = 0;
+        if (!parseAIGs(*pool, sc.pos(), end, sc.line(), andEnd)) return false;
+        sc.seek(andEnd, sc.line() + A);
+        i = A;
+    }
+    for (; i < A; ++i, sc.nextLine()) {
+        int lid0, lid1;
+        lineNo = sc.line() - 1;
+        if (!sc.readInt(lid) || !sc.readInt(lid0) || !sc.readInt(lid1)) {
+            errMsg = "AIG";
+            return parseError(MISSING_DEF);
+        }
+        if (toID(lid) > _MaxIndex) {
+            errInt = lid;
+            return parseError(MAX_LIT_ID);
+        }
+        addAIG(lid, lid0, lid1, sc.line());
+    }
+
+    string name;
+    if (deferSymbols(sc.pos() - begin)) sc.seek(end, sc.line());
+    for (; !sc.eof(); sc.nextLine()) {
+        char type = sc.peek();
+        if (type == 'c') break;
+        if (type != 'i' && type != 'o') continue;
+        int idx;
+        sc.skip();
+        if (!sc.readInt(idx) || !sc.readWord(name)) continue;
+        if (idx < (type == 'i' ? _InputNum : _OutputNum))
+            setIOSymbol(type, idx, name);
+    }
+
+    buildConnection(linePO, pool);
+    sort(_LAIGs.begin(), _LAIGs.end());
+    return true;
+}
+
+// The AND section is cut into newline-aligned chunks, one per thread. A
+// newline count per chunk tells each thread the index of its first AND, so
+// the triples are parsed straight into one preallocated array. The CirAIG
+// objects are then built serially from that array.
+bool CirMgr::parseAIGs(ThreadPool& pool, const char* begin, const char* end,
+                       int firstLine, const char*& andEnd) {
+    int A = _AIGNum;
+    size_t T = pool.size();
+    vector<const char*> cut(T + 1, end);
+    cut[0] = begin;
+    for (size_t t = 1; t < T; ++t) {
+        const char* c = max(cut[t - 1], begin + (end - begin) * t / T);
+        const char* nl = (const char*)memchr(c, '\n', end - c);
+        cut[t] = nl ? nl + 1 : end;
+    }
+
+    vector<int> first(T + 1, 0);
+    pool.run([&](size_t t) {
+        int lines = 0;
+        for (const char* p = cut[t]; p < cut[t + 1]; ++lines) {
+            const char* nl = (const char*)memchr(p, '\n', cut[t + 1] - p);
+            p = nl ? nl + 1 : cut[t + 1];
+        }
+        first[t + 1] = lines;
+    });
+    for (size_t t = 0; t < T; ++t)
+        first[t + 1] += first[t];
+    if (first[T] < A) {
+        lineNo = firstLine + first[T] - 1;
+        errMsg = "AIG";
+        return parseError(MISSING_DEF);
+    }
+
+    vector<int> lits(3 * A);
+    vector<int> badLine(T, -1);
+    pool.run([&](size_t t) {
+        AagScanner sc(cut[t], cut[t + 1]);
+        for (int i = first[t]; i < A && !sc.eof(); ++i, sc.nextLine()) {
+            int* l = &lits[3 * i];
+            if (!sc.readInt(l[0]) || !sc.readInt(l[1]) || !sc.readInt(l[2]) ||
+                toID(l[0]) > _MaxIndex) {
+                badLine[t] = i;
+                return;
+            }
+            if (i == A - 1) {
+                sc.nextLine();
+                andEnd = sc.pos();
+            }
+        }
+    });
+    for (size_t t = 0; t < T; ++t) {
+        if (badLine[t] < 0) continue;
+        lineNo = firstLine + badLine[t] - 1;
+        errMsg = "AIG";
+        return parseError(MISSING_DEF);
+    }
+
+    if (_strashOnRead) {
+        for (int i = 0; i < A; ++i)
+            addAIG(lits[3 * i], lits[3 * i + 1], lits[3 * i + 2], firstLine + i);
+        return true;
+    }
+    // the gate arena is not thread-safe; allocating from it is cheap anyway
+    for (int i = 0; i < A; ++i) {
+        int id = toID(lits[3 * i]);
+        createGate(GATE_AIG, id)->setLineNo(firstLine + i);
+        setFanIn(id, lits[3 * i + 1], lits[3 * i + 2]);
+        _LAIGs.push_back(lits[3 * i]);
+        _active[id] = true;
+    }
+    return true;
+}
+
+// READ_PIPELINE: the parsing thread hands AND definitions over in batches
+// through a bounded queue. A consumer thread hashes them, links fanouts
+// and computes levels while the rest of the file is still being read.
+class CirPipe {
+   public:
+    enum { BATCH = 4096, DEPTH = 16 };
+    CirPipe() : _queue(DEPTH), _abort(false) { _batch.reserve(4 * BATCH); }
+
+    void push(int lid, int lid0, int lid1, int line) {
+        int def[4] = {lid, lid0, lid1, line};
+        _batch.insert(_batch.end(), def, def + 4);
+        if (_batch.size() == 4 * BATCH) flush();
+    }
+    bool pop(vector<int>& batch) { return _queue.pop(batch); }
+    void close() {
+        flush();
+        _queue.close();
+        if (_consumer.joinable()) _consumer.join();
+    }
+    // a failed read: the queued batches are dropped, not built
+    void abort() {
+        _abort = true;
+        _batch.clear();
+        _queue.close();
+        if (_consumer.joinable()) _consumer.join();
+    }
+    bool aborted() const { return _abort; }
+
+    thread _consumer;
+    chrono::steady_clock::time_point _start;
+    int _nRead;
+
+   private:
+    void flush() {
+        if (_batch.empty()) return;
+        _queue.push(_batch);
+        _batch.clear();
+        _batch.reserve(4 * BATCH);
+    }
+    BoundedQueue<vector<int>> _queue;
+    vector<int> _batch;
+    atomic<bool> _abort;
+};
+
+void CirMgr::startPipeline() {
+    _pipe = new CirPipe;
+    _pipe->_start = chrono::steady_clock::now();
+    _pipe->_nRead = 0;
+    _level.assign(_gates.size(), 0);
+    _pipe->_consumer = thread([this] {
+        vector<int> batch;
+        while (_pipe->pop(batch)) {
+            if (_pipe->aborted()) continue;
+            for (size_t i = 0; i < batch.size(); i += 4)
+                strashAIG(batch[i], batch[i + 1], batch[i + 2], batch[i + 3]);
+        }
+        if (!_pipe->aborted()) strashPending();
+    });
+}
+
+// wait for the consumer; false if there was no pipeline to finish
+bool CirMgr::finishPipeline() {
+    if (!_pipe) return false;
+    _pipe->close();
+    double sec = chrono::duration<double>(chrono::steady_clock::now() -
+                                          _pipe->_start).count();
+    printf("Pipelined %d AIGs into %d in %.3f s (depth %d)\n", _pipe->_nRead,
+           (int)_LAIGs.size(), sec,
+           _level.empty() ? 0 : *max_element(_level.begin(), _level.end()));
+    delete _pipe;
+    _pipe = 0;
+    return true;
+}
+
+void CirMgr::abortPipeline() {
+    if (!_pipe) return;
+    _pipe->abort();
+    delete _pipe;
+    _pipe = 0;
+}
+
+// called by the consumer for each AND that survives hashing
+void CirMgr::linkAIG(int id) {
+    for (int i = 0; i < 2; i++) {
+        int lid = fanIn(id, i), in = toID(lid);
+        if (in > _MaxIndex || _gates[in] == nullptr) continue;
+        addFanOut(in, toLID(id, lid), i);
+        _level[id] = max(_level[id], _level[in] + 1);
+    }
+}
+
+// Every parser creates its ANDs here. With READ_STRASH they go through
+// strashAIG() instead, so structural duplicates are never allocated.
+void CirMgr::addAIG(int lid, int lid0, int lid1, int line) {
+    if (_pipeOnRead) {
+        if (!_pipe) startPipeline();
+        _pipe->push(lid, lid0, lid1, line);
+        ++_pipe->_nRead;
+        return;
+    }
+    if (_strashOnRead) {
+        strashAIG(lid, lid0, lid1, line);
+        return;
+    }
+    int id = toID(lid);
+    _LAIGs.push_back(lid);
+    createGate(GATE_AIG, id)->setLineNo(line);
+    _active[id] = true;
+    setFanIn(id, lid0, lid1);
+}
+
+void CirMgr::buildConnection(const vector<int>& linePO, ThreadPool* pool) {
+    bool linked = finishPipeline();
+    if (_strashOnRead && !linked) strashPending();
     for (int i = 0, id = _MaxIndex + 1; i < _OutputNum; ++i, ++id) {
-        _gates[id] = new CirPO(id);
+        createGate(GATE_PO, id)->setLineNo(linePO[i]);
         _active[id] = true;
-        int lidOut = _LOutputs[i];
-        int idOut = toID(lidOut);
-
-        if (_gates[idOut] != nullptr) {
-            _gates[id]->addFanIn(lidOut);
-            _gates[id]->setSymbol(_gates[idOut]->symbol());
-            if (_gates[idOut]->type() != GATE_PI) _gates[idOut]->setSymbol("");
-            _gates[id]->setLineNo(linePO[i]);
-            _gates[idOut]->addFanOut(toLID(id, lidOut));
-            _LOutputs[i] = toLID(id);
+        setFanIn(id, _LOutputs[i]);
+        _LOutputs[i] = toLID(id);
+    }
+    if (linked) {
+        // AND fanouts are in place already, in the order the ANDs were
+        // built; lay them out again in id order with the PO fanouts first
+        int n = _gates.size();
+        GateList size(_foSize), count(_foSize), begin(_foBegin), lits;
+        for (int id = _MaxIndex + 1; id < n; id++) {
+            int out = toID(_fanin0[id]);
+            if (out <= _MaxIndex && _gates[out] != nullptr) ++count[out];
+        }
+        lits.swap(_foLits);
+        initFanOut(count);
+        for (int id = _MaxIndex + 1; id < n; id++) {
+            int lidOut = _fanin0[id], out = toID(lidOut);
+            if (out <= _MaxIndex && _gates[out] != nullptr)
+                addFanOut(out, toLID(id, lidOut), 0);
+        }
+        for (int id = 0; id <= _MaxIndex; id++) {
+            GateList::iterator first = lits.begin() + begin[id];
+            GateList::iterator last = first + size[id];
+            sort(first, last);
+            copy(first, last, _foLits.begin() + _foBegin[id] + _foSize[id]);
+            _foSize[id] += size[id];
+            indexFanOut(id);
+        }
+    } else if (pool && pool->size() > 1) {
+        buildFanOut(*pool);
+    } else {
+        buildFanOut();
+    }
+    countRefs();
+}
+
+// _refCount[id] counts the fanin slots of active gates that hold id; the
+// active ANDs nobody uses are the seeds sweep() starts from.
+void CirMgr::countRefs() const {
+    int n = _gates.size();
+    _refCount.assign(n, 0);
+    for (int id = 0; id < n; id++) {
+        if (_gates[id] == nullptr || !active(id)) continue;
+        for (int i = 0; i < fanInSize(id); i++) {
+            int in = toID(fanIn(id, i));
+            if (in < n) ++_refCount[in];
+        }
+    }
+    _deadAIGs.clear();
+    for (int i = 0; i < _LAIGs.size(); i++) {
+        int id = toID(_LAIGs[i]);
+        if (active(id) && _refCount[id] == 0) _deadAIGs.push_back(id);
+    }
+}
+
+// Deactivate the active gate id and drop its references; every AND of its
+// fanin cone left without a live reference goes too, is unlinked from the
+// fanout lists of its fanins and is appended to removed.
+void CirMgr::release(int id, GateList& removed) {
+    GateList stack(1, id);
+    deactivate(id);
+    while (!stack.empty()) {
+        int g = stack.back();
+        stack.pop_back();
+        for (int i = 0; i < fanInSize(g); i++) {
+            int in = toID(fanIn(g, i));
+            if (--_refCount[in] != 0 || !isAIG(in) || !active(in)) continue;
+            deactivate(in);
+            removeOut(in, in);
+            removed.push_back(in);
+            stack.push_back(in);
+        }
+    }
+}
+
+// Lay out an empty slice with room for count[id] fanouts for every gate
+void CirMgr::initFanOut(const GateList& count) {
+    int n = _gates.size(), total = 0;
+    _foBegin.resize(n);
+    _foSize.assign(n, 0);
+    _foCap.resize(n);
+    for (int id = 0; id < n; ++id) {
+        _foBegin[id] = total;
+        _foCap[id] = count[id];
+        total += count[id];
+    }
+    _foLits.assign(total, -1);
+    _foDead = 0;
+    _edgePos0.assign(n, -1);
+    _edgePos1.assign(n, -1);
+}
+
+// Append the edge of fanin slot "slot" of toID(lid). A full slice moves to
+// the end of _foLits (or grows in place if it is there already); the old
+// slots become tombstones.
+void CirMgr::addFanOut(int id, int lid, int slot) {
+    if (_foSize[id] == _foCap[id]) {
+        int cap = max(4, 2 * _foCap[id]);
+        if (_foBegin[id] + _foCap[id] == (int)_foLits.size()) {
+            _foLits.resize(_foBegin[id] + cap, -1);
         } else {
-            _gates[id]->addFanIn(lidOut);
-            _gates[id]->setLineNo(linePO[i]);
-            _LOutputs[i] = toLID(id);
+            int begin = _foLits.size();
+            _foLits.resize(begin + cap, -1);
+            for (int i = 0; i < _foSize[id]; i++) {
+                _foLits[begin + i] = _foLits[_foBegin[id] + i];
+                _foLits[_foBegin[id] + i] = -1;
+            }
+            _foDead += _foCap[id];
+            _foBegin[id] = begin;
         }
+        _foCap[id] = cap;
+        if (_foDead > _foLits.size() / 2) compactFanOut();
     }
-    for (int id = 0; id <= _MaxIndex; id++) {
-        if (_gates[id] != nullptr) {
-            const GateList fanIn = _gates[id]->LFanIn();
-            if (!fanIn.empty()) {
-                for (int i = 0; i < fanIn.size(); i++) {
-                    if (_gates[toID(fanIn[i])] != nullptr)
-                        _gates[toID(fanIn[i])]->addFanOut(toLID(id, fanIn[i]));
-                }
+    edgePosRef(toID(lid), slot) = _foSize[id];
+    _foLits[_foBegin[id] + _foSize[id]++] = lid;
+}
+
+// swap the i-th fanout with the last one and tell the moved edge its new
+// place; the slice keeps its room
+void CirMgr::removeFanOut(int id, int i) {
+    int last = _foSize[id] - 1;
+    if (i != last) {
+        int slot = fanOutSlot(id, last);
+        fanOutRef(id, i) = fanOut(id, last);
+        if (slot >= 0) edgePosRef(toID(fanOut(id, i)), slot) = i;
+    }
+    fanOutRef(id, last) = -1;
+    --_foSize[id];
+}
+
+// the fanin slot of toID(fanOut(id, i)) whose edge is the i-th fanout of
+// id, or -1 if the entry is a stale copy
+int CirMgr::fanOutSlot(int id, int i) const {
+    int out = toID(fanOut(id, i));
+    for (int j = 0; j < fanInSize(out); j++)
+        if (toID(fanIn(out, j)) == id && edgePos(out, j) == i) return j;
+    return -1;
+}
+
+// drop the edge of fanin slot i of id from the fanout slice it sits in
+void CirMgr::unlinkFanIn(int id, int i) {
+    int pos = edgePos(id, i);
+    if (pos < 0) return;
+    edgePosRef(id, i) = -1;
+    removeFanOut(toID(fanIn(id, i)), pos);
+}
+
+// Point the fanin slots fed by the slice of id at their edges, for slices
+// filled in bulk; with both fanins on one literal, slot 0 takes the first.
+void CirMgr::indexFanOut(int id) {
+    for (int i = 0; i < _foSize[id]; i++) {
+        int lid = fanOut(id, i), out = toID(lid);
+        for (int j = 0; j < fanInSize(out); j++) {
+            int in = fanIn(out, j);
+            if (toID(in) == id && isInv(in) == isInv(lid) &&
+                edgePos(out, j) < 0) {
+                edgePosRef(out, j) = i;
+                break;
             }
         }
     }
-    aigerFile.close();
+}
 
-    sort(_LAIGs.begin(), _LAIGs.end());
-    return true;
+void CirMgr::compactFanOut() {
+    GateList lits;
+    lits.reserve(_foLits.size() - _foDead);
+    for (int id = 0; id < _foBegin.size(); ++id) {
+        GateList::iterator first = _foLits.begin() + _foBegin[id];
+        _foBegin[id] = lits.size();
+        _foCap[id] = _foSize[id];
+        lits.insert(lits.end(), first, first + _foSize[id]);
+    }
+    _foLits.swap(lits);
+    _foDead = 0;
+}
+
+// Serial counting pass: size every slice, then fill them in the order the
+// lists have always had (PO fanouts first, then by id).
+void CirMgr::buildFanOut() {
+    int n = _gates.size();
+    GateList count(n, 0);
+    for (int id = 0; id < n; ++id) {
+        for (int i = 0; i < fanInSize(id); i++) {
+            int idIn = toID(fanIn(id, i));
+            if (idIn < n && _gates[idIn] != nullptr) ++count[idIn];
+        }
+    }
+    initFanOut(count);
+    auto link = [&](int id) {
+        for (int i = 0; i < fanInSize(id); i++) {
+            int lid = fanIn(id, i), idIn = toID(lid);
+            if (idIn < n && _gates[idIn] != nullptr)
+                addFanOut(idIn, toLID(id, lid), i);
+        }
+    };
+    for (int id = _MaxIndex + 1; id < n; id++) link(id);
+    for (int id = 0; id <= _MaxIndex; id++) link(id);
+}
+
+// Parallel counting pass: count the fanouts of every gate, turn the counts
+// into offsets, scatter the edges, then sort each slice so the lists come
+// out in the same order as the serial loop (PO fanouts first, then by id).
+void CirMgr::buildFanOut(ThreadPool& pool) {
+    int n = _gates.size();
+    vector<atomic<int> > count(n);
+    pool.parallelFor(n, [&](size_t b, size_t e) {
+        for (size_t id = b; id < e; ++id) {
+            for (int i = 0; i < fanInSize(id); i++) {
+                int idIn = toID(fanIn(id, i));
+                if (idIn < n && _gates[idIn] != nullptr)
+                    count[idIn].fetch_add(1, memory_order_relaxed);
+            }
+        }
+    });
+
+    GateList size(n);
+    for (int id = 0; id < n; ++id) {
+        size[id] = count[id].load(memory_order_relaxed);
+        count[id].store(0, memory_order_relaxed);
+    }
+    initFanOut(size);
+
+    pool.parallelFor(n, [&](size_t b, size_t e) {
+        for (size_t id = b; id < e; ++id) {
+            for (int i = 0; i < fanInSize(id); i++) {
+                int lid = fanIn(id, i), idIn = toID(lid);
+                if (idIn < n && _gates[idIn] != nullptr) {
+                    int pos = count[idIn].fetch_add(1, memory_order_relaxed);
+                    _foLits[_foBegin[idIn] + pos] = toLID(id, lid);
+                }
+            }
+        }
+    });
+
+    int maxIndex = _MaxIndex;
+    auto poFirst = [maxIndex](int a, int b) {
+        bool poA = toID(a) > maxIndex, poB = toID(b) > maxIndex;
+        return poA != poB ? poA : a < b;
+    };
+    pool.parallelFor(n, [&](size_t b, size_t e) {
+        for (size_t id = b; id < e; ++id) {
+            GateList::iterator first = _foLits.begin() + _foBegin[id];
+            _foSize[id] = size[id];
+            sort(first, first + size[id], poFirst);
+            indexFanOut(id);
+        }
+    });
 }
 void CirMgr::printSummary() const {
-    getActiveAIGCount();
+    // packing swept the circuit, so its active ANDs are the reachable ones
+    if (_packed) {
+        _activeAIGCount = 0;
+        for (int i = 0; i < _LAIGs.size(); i++)
+            if (active(toID(_LAIGs[i]))) ++_activeAIGCount;
+    } else {
+        getActiveAIGCount();
+    }
     cout << endl;
     cout << "Circuit Statistics" << endl
          << "==================" << endl
@@ -267,33 +1044,19 @@ void CirMgr::printSummary() const {
          << _LInputs.size() + _LOutputs.size() + _activeAIGCount << endl;
 }
 void CirMgr::printNetlist() const {
-    cout << endl;
-    int idx = 0;
-
-    resetVisit();
-    for (int i = 0; i < _LOutputs.size(); i++)
-        printNetlist(toID(_LOutputs[i]), idx);
-    return;
-}
-void CirMgr::printNetlist(int id, int& idx) const {
-    if (!_active[id]) return;
-    if (visited(id)) return;
-    visit(id);
-    CirGate* gate = _gates[id];
-
-    for (int i = 0; i < gate->LFanIn().size(); i++) {
-        CirGate* fanIn = _gates[toID(gate->LFanIn()[i])];
-        if (fanIn != nullptr) printNetlist(fanIn->id(), idx);
+    BufWriter out(cout);
+    out << '\n';
+    const GateList& dfs = dfsList();
+    for (int idx = 0; idx < dfs.size(); idx++) {
+        out << "[" << idx << "] ";
+        _gates[dfs[idx]]->printGate(out);
+        out << '\n';
     }
-
-    cout << "[" << idx++ << "] ";
-    gate->printGate();
-    cout << endl;
 }
 void CirMgr::getNotUsed() const {
     for (int id = 1; id <= _MaxIndex; id++)
         if (_gates[id] != nullptr)
-            if (_gates[id]->LFanOut().empty()) _notUsed.push_back(id);
+            if (fanOutSize(id) == 0) _notUsed.push_back(id);
     return;
 }
 void CirMgr::printPIs() const {
@@ -314,9 +1077,8 @@ void CirMgr::printFloatGates() const {
     for (int i = 0; i < _LAIGs.size(); i++) {
         int id = toID(_LAIGs[i]);
         if (!_active[id]) continue;
-        CirGate* gate = _gates[id];
-        if (_gates[toID(gate->LFanIn()[0])] == nullptr ||
-            _gates[toID(gate->LFanIn()[1])] == nullptr) {
+        if (_gates[toID(_fanin0[id])] == nullptr ||
+            _gates[toID(_fanin1[id])] == nullptr) {
             if (!prompted) {
                 cout << "Gates with floating fanin(s):";
                 prompted = true;
@@ -353,86 +1115,99 @@ void CirMgr::printFECPairs() const {
     }
 }
 void CirMgr::getAIGReachability(int id, GateList& aigs) const {
-    if (visited(id)) return;
-    visit(id);
-    CirGate* gate = _gates[id];
+    walk(id, [this](int id) { return firstVisit(id); },
+         [this](int in) { return _gates[in] != nullptr; },
+         [&](int id) {
+             if (isAIG(id)) aigs.push_back(id);
+         });
+}
 
-    for (int i = 0; i < gate->LFanIn().size(); i++) {
-        CirGate* fanIn = _gates[toID(gate->LFanIn()[i])];
-        if (fanIn != nullptr) getAIGReachability(fanIn->id(), aigs);
+const GateList& CirMgr::dfsList() const {
+    if (!_dfsValid) {
+        _dfsList.clear();
+        resetVisit();
+        for (int i = 0; i < _LOutputs.size(); i++)
+            walk(toID(_LOutputs[i]),
+                 [this](int id) { return firstVisit(id); },
+                 [this](int in) { return active(in); },
+                 [this](int id) { _dfsList.push_back(id); });
+        _dfsValid = true;
+        _simOpsValid = false;
     }
-
-    if (isAIG(id)) aigs.push_back(id);
+    return _dfsList;
 }
 
 void CirMgr::getActiveAIGCount() const {
     _activeAIGCount = 0;
+    _dfsValid = false;
 
     fill(_active.begin(), _active.end(), false);
     for (int i = 0; i < _LOutputs.size(); i++)
-        getActiveAIGCount(toID(_LOutputs[i]));
+        walk(toID(_LOutputs[i]),
+             [this](int id) {
+                 return _active[id] ? false : (_active[id] = true, true);
+             },
+             [this](int in) { return _gates[in] != nullptr; },
+             [this](int id) {
+                 if (isAIG(id)) ++_activeAIGCount;
+             });
 
     _active[0] = true;
     for (int i = 0; i < _LInputs.size(); i++)
         _active[toID(_LInputs[i])] = true;
-}
-void CirMgr::getActiveAIGCount(int id) const {
-    if (_active[id]) return;
-    _active[id] = true;
-    CirGate* gate = _gates[id];
-    GateList& LFanIn = gate->LFanIn();
-
-    for (int i = 0; i < LFanIn.size(); i++) {
-        if (_gates[toID(LFanIn[i])] != nullptr)
-            getActiveAIGCount(toID(LFanIn[i]));
-    }
-    if (isAIG(id)) ++_activeAIGCount;
+    countRefs();
 }
 
-void CirMgr::writeAag(ostream& outfile) const {
+void CirMgr::writeAag(ostream& os) const {
+    BufWriter outfile(os);
     outfile << "aag " << _MaxIndex << " " << _InputNum << " " << _LatchNum
             << " " << _OutputNum << " ";
 
-    GateList idReachableAIGs;
-    resetVisit();
-    for (int i = 0; i < _LOutputs.size(); i++)
-        getAIGReachability(toID(_LOutputs[i]), idReachableAIGs);
+    GateList idReachableAIGs, lidOutputs;
+    reachableAIGs(idReachableAIGs, lidOutputs);
 
-    outfile << idReachableAIGs.size() << endl;
+    outfile << idReachableAIGs.size() << '\n';
 
     for (int i = 0; i < _LInputs.size(); i++)
-        outfile << _LInputs[i] << endl;
-    for (int i = 0; i < _LOutputs.size(); i++)
-        outfile << _gates[toID(_LOutputs[i])]->LFanIn()[0] << endl;
+        outfile << _LInputs[i] << '\n';
+    for (int i = 0; i < lidOutputs.size(); i++)
+        outfile << lidOutputs[i] << '\n';
 
-    for (int i = 0; i < idReachableAIGs.size(); i++) {
-        CirGate* gate = _gates[idReachableAIGs[i]];
-        outfile << toLID(idReachableAIGs[i]) << " ";
-        outfile << gate->LFanIn()[0] << " ";
-        outfile << gate->LFanIn()[1] << endl;
+    if (_packed) {
+        CirPackedFanIn::Reader r(*_packed);
+        int id, lid0, lid1;
+        while (r.next(id, lid0, lid1))
+            if (isAIG(id) && active(id))
+                outfile << toLID(id) << " " << lid0 << " " << lid1 << '\n';
+    } else {
+        for (int i = 0; i < idReachableAIGs.size(); i++) {
+            int id = idReachableAIGs[i];
+            outfile << toLID(id) << " ";
+            outfile << _fanin0[id] << " ";
+            outfile << _fanin1[id] << '\n';
+        }
     }
     for (int i = 0; i < _LInputs.size(); i++) {
         int id = toID(_LInputs[i]);
-        CirGate* gate = _gates[id];
-        if (gate->hasSymbol())
-            outfile << "i" << i << " " << gate->symbol() << endl;
+        if (hasSymbol(id))
+            outfile << "i" << i << " " << getSymbol(id) << '\n';
     }
     for (int i = 0; i < _LOutputs.size(); i++) {
         int id = toID(_LOutputs[i]);
-        CirGate* gate = _gates[id];
-        if (gate->hasSymbol())
-            outfile << "o" << i << " " << gate->symbol() << endl;
+        if (hasSymbol(id))
+            outfile << "o" << i << " " << getSymbol(id) << '\n';
     }
 
-    outfile << "c" << endl;
-    outfile << "Comment comment comment..." << endl;
+    outfile << "c" << '\n';
+    outfile << "Comment comment comment..." << '\n';
 }
 
 static GateList _LGateInputs;
 static GateList _LGateAIGs;
 static int _GateMaxIndex;
 
-void CirMgr::writeGate(ostream& outfile, CirGate* g) const {
+void CirMgr::writeGate(ostream& os, CirGate* g) const {
+    BufWriter outfile(os);
     _LGateInputs.clear();
     _LGateAIGs.clear();
     int id = g->id();
@@ -443,71 +1218,222 @@ void CirMgr::writeGate(ostream& outfile, CirGate* g) const {
     writeGate(id);
 
     outfile << "aag " << _GateMaxIndex << " " << _LGateInputs.size() << " 0 1 "
-            << _LGateAIGs.size() << endl;
+            << _LGateAIGs.size() << '\n';
 
     sort(_LGateInputs.begin(), _LGateInputs.end());
     for (int i = 0; i < _LGateInputs.size(); i++)
-        outfile << _LGateInputs[i] << endl;
+        outfile << _LGateInputs[i] << '\n';
 
-    cout << toLID(id) << endl;
+    outfile << toLID(id) << '\n';
 
     for (int i = 0; i < _LGateAIGs.size(); i++) {
-        CirGate* gate = _gates[toID(_LGateAIGs[i])];
+        int id = toID(_LGateAIGs[i]);
         outfile << _LGateAIGs[i] << " ";
-        outfile << gate->LFanIn()[0] << " " << gate->LFanIn()[1] << endl;
+        outfile << _fanin0[id] << " " << _fanin1[id] << '\n';
     }
     for (int i = 0; i < _LGateInputs.size(); i++) {
         int id = toID(_LGateInputs[i]);
-        CirGate* gate = _gates[id];
-        if (gate->hasSymbol())
-            outfile << "i" << i << " " << gate->symbol() << endl;
+        if (hasSymbol(id))
+            outfile << "i" << i << " " << getSymbol(id) << '\n';
     }
-    if (_gates[id]->hasSymbol())
-        outfile << "o0 " << _gates[id]->symbol() << endl;
+    if (hasSymbol(id))
+        outfile << "o0 " << getSymbol(id) << '\n';
     else
-        outfile << "o0 " << id << endl;
+        outfile << "o0 " << id << '\n';
 
-    outfile << "c" << endl;
-    outfile << "Comment comment comment..." << endl;
+    outfile << "c" << '\n';
+    outfile << "Comment comment comment..." << '\n';
 }
 
-void CirMgr::writeGate(int id) const {
-    if (visited(id)) return;
-    visit(id);
-    CirGate* gate = _gates[id];
-    GateList& LFanIn = gate->LFanIn();
+// Binary AIGER output: PIs are renumbered 1..I in _LInputs order and the
+// reachable AIGs I+1..I+A in DFS (topological) order, so every AND can be
+// written as two varint deltas. Undefined fanins are tied to constant 0.
+static void encodeDelta(BufWriter& out, unsigned delta) {
+    while (delta & ~0x7fu) {
+        out << (char)((delta & 0x7f) | 0x80);
+        delta >>= 7;
+    }
+    out << (char)delta;
+}
+
+void CirMgr::writeAig(ostream& os) const {
+    BufWriter outfile(os);
+    GateList idInputs, lidOutputs, idReachableAIGs;
+    reachableAIGs(idReachableAIGs, lidOutputs);
+    for (int i = 0; i < _LInputs.size(); i++)
+        idInputs.push_back(toID(_LInputs[i]));
+
+    writeAig(outfile, idInputs, lidOutputs, idReachableAIGs);
+
+    for (int i = 0; i < idInputs.size(); i++) {
+        if (hasSymbol(idInputs[i]))
+            outfile << "i" << i << " " << getSymbol(idInputs[i]) << '\n';
+    }
+    for (int i = 0; i < _LOutputs.size(); i++) {
+        int id = toID(_LOutputs[i]);
+        if (hasSymbol(id)) outfile << "o" << i << " " << getSymbol(id) << '\n';
+    }
+    outfile << "c\nComment comment comment...\n";
+}
+
+void CirMgr::writeGateAig(ostream& os, CirGate* g) const {
+    BufWriter outfile(os);
+    GateList idInputs, lidOutputs(1, toLID(g->id())), idConeAIGs;
+    resetVisit();
+    getAIGReachability(g->id(), idConeAIGs);
+    for (int i = 0; i < _LInputs.size(); i++)
+        if (visited(toID(_LInputs[i]))) idInputs.push_back(toID(_LInputs[i]));
+
+    writeAig(outfile, idInputs, lidOutputs, idConeAIGs);
+
+    for (int i = 0; i < idInputs.size(); i++) {
+        if (hasSymbol(idInputs[i]))
+            outfile << "i" << i << " " << getSymbol(idInputs[i]) << '\n';
+    }
+    if (hasSymbol(g->id()))
+        outfile << "o0 " << getSymbol(g->id()) << '\n';
+    else
+        outfile << "o0 " << g->id() << '\n';
+    outfile << "c\nComment comment comment...\n";
+}
+
+void CirMgr::writeAig(BufWriter& outfile, const GateList& idInputs,
+                      const GateList& lidOutputs,
+                      const GateList& idAIGs) const {
+    vector<int> newID(_gates.size(), 0);
+    int M = 0;
+    for (int i = 0; i < idInputs.size(); i++)
+        newID[idInputs[i]] = ++M;
+    for (int i = 0; i < idAIGs.size(); i++)
+        newID[idAIGs[i]] = ++M;
 
-    _GateMaxIndex = std::max(id, _GateMaxIndex);
-    if (isAIG(id))
-        _LGateAIGs.push_back(toLID(id));
-    else if (isPI(id))
-        _LGateInputs.push_back(toLID(id));
+    outfile << "aig " << M << " " << idInputs.size() << " 0 "
+            << lidOutputs.size() << " " << idAIGs.size() << '\n';
+    for (int i = 0; i < lidOutputs.size(); i++)
+        outfile << toLID(newID[toID(lidOutputs[i])], lidOutputs[i]) << '\n';
+
+    // packed fanins are read alongside idAIGs, which is then in id order
+    CirPackedFanIn none;
+    CirPackedFanIn::Reader r(_packed ? *_packed : none);
+    for (int i = 0; i < idAIGs.size(); i++) {
+        int lid0 = 0, lid1 = 0;
+        if (_packed) {
+            for (int id; r.next(id, lid0, lid1) && id != idAIGs[i];) {}
+        } else {
+            lid0 = _fanin0[idAIGs[i]], lid1 = _fanin1[idAIGs[i]];
+        }
+        int lhs = toLID(newID[idAIGs[i]]);
+        int rhs0 = toLID(newID[toID(lid0)], lid0);
+        int rhs1 = toLID(newID[toID(lid1)], lid1);
+        if (rhs0 < rhs1) swap(rhs0, rhs1);
+        encodeDelta(outfile, lhs - rhs0);
+        encodeDelta(outfile, rhs0 - rhs1);
+    }
+}
 
-    for (int i = 0; i < LFanIn.size(); i++) {
-        int id = toID(LFanIn[i]);
-        if (active(id)) writeGate(id);
+// The ANDs a full netlist dump writes (in DFS order, or in id order when
+// the fanins are packed) and the PO fanins
+void CirMgr::reachableAIGs(GateList& idAIGs, GateList& lidOutputs) const {
+    if (_packed) {
+        CirPackedFanIn::Reader r(*_packed);
+        int id, lid0, lid1;
+        while (r.next(id, lid0, lid1)) {
+            if (isPO(id))
+                lidOutputs.push_back(lid0);
+            else if (active(id))
+                idAIGs.push_back(id);
+        }
+        return;
     }
+    for (int id : dfsList())
+        if (isAIG(id)) idAIGs.push_back(id);
+    for (int i = 0; i < _LOutputs.size(); i++)
+        lidOutputs.push_back(_fanin0[toID(_LOutputs[i])]);
+}
+
+// collects the cone in pre-order
+void CirMgr::writeGate(int id) const {
+    auto enter = [this](int id) {
+        if (!firstVisit(id)) return false;
+        _GateMaxIndex = std::max(id, _GateMaxIndex);
+        if (isAIG(id))
+            _LGateAIGs.push_back(toLID(id));
+        else if (isPI(id))
+            _LGateInputs.push_back(toLID(id));
+        return true;
+    };
+    walk(id, enter, [this](int in) { return active(in); }, [](int) {});
 }
 
-GateList& CirMgr::LFanInOf(int id) { return _gates[id]->LFanIn(); }
-GateList& CirMgr::LFanOutOf(int id) { return _gates[id]->LFanOut(); }
-bool CirMgr::isAIG(int id) const { return _gates[id]->type() == GATE_AIG; }
-bool CirMgr::isPI(int id) const { return _gates[id]->type() == GATE_PI; }
-bool CirMgr::isPO(int id) const { return _gates[id]->type() == GATE_PO; }
-bool CirMgr::isCONST0(int id) const {
-    return _gates[id]->type() == GATE_CONST0;
+// All gates are created here, so the flat core (_type, _fanin0/1) always
+// matches _gates; CirGate only keeps what the reporting commands need.
+// The gate classes add no data to CirGate, so each one takes one arena slot.
+CirGate* CirMgr::createGate(GateType type, int id) {
+    static_assert(sizeof(CirAIG) == sizeof(CirGate) &&
+                      sizeof(CirPI) == sizeof(CirGate) &&
+                      sizeof(CirPO) == sizeof(CirGate) &&
+                      sizeof(Cir0) == sizeof(CirGate),
+                  "gates must fit a MemMgr<CirGate> slot");
+    if (type < GATE_AIG || type >= GATE_UNDEF) return 0;
+    void* mem = _gateMem->alloc(sizeof(CirGate));
+    CirGate* gate = 0;
+    switch (type) {
+        case GATE_AIG: gate = new (mem) CirAIG(id); break;
+        case GATE_PI: gate = new (mem) CirPI(id); break;
+        case GATE_PO: gate = new (mem) CirPO(id); break;
+        default: gate = new (mem) Cir0(id); break;
+    }
+    gate->_FECGroupIt = _noFECGroup.begin();
+    gate->_FECInv = false;
+    _gates[id] = gate;
+    _type[id] = type;
+    return gate;
+}
+void CirMgr::setFanIn(int id, int lid0, int lid1) {
+    _fanin0[id] = lid0;
+    _fanin1[id] = lid1;
 }
 void CirMgr::deactivate(int id) { _active[id] = false; }
 
 void CirMgr::reset() {
-    for (int i = 0; i < _gates.size(); i++)
-        if (_gates[i] != nullptr) delete _gates[i];
+    // the consumer of a failed pipelined read still writes to the netlist
+    abortPipeline();
+    _gateMem->reset();
     _gates.clear();
+    _type.clear();
+    _fanin0.clear();
+    _fanin1.clear();
+    delete _packed;
+    _packed = 0;
+    _foBegin.clear();
+    _foSize.clear();
+    _foCap.clear();
+    _foLits.clear();
+    _foDead = 0;
+    _edgePos0.clear();
+    _edgePos1.clear();
     _active.clear();
     _LInputs.clear();
     _LOutputs.clear();
     _LAIGs.clear();
     _notUsed.clear();
+    _symArena.clear();
+    _symOfs.clear();
+    _symFile.clear();
+    _symPos = string::npos;
+    _srcFile.clear();
+    _srcHash = 0;
+    _strashOnRead = false;
+    _pipeOnRead = false;
+    GateList().swap(_strashLit);
+    GateList().swap(_strashQueue);
+    _level.clear();
+    _dfsList.clear();
+    _dfsValid = false;
+    _simOps.clear();
+    _simLevelOfs.clear();
+    _simOpsValid = false;
+    _simWord.clear();
 }
 void CirMgr::setHeader(int M, int I, int L, int O, int A) {
     _MaxIndex = M;
@@ -516,13 +1442,35 @@ void CirMgr::setHeader(int M, int I, int L, int O, int A) {
     _OutputNum = O;
     _AIGNum = A;
     _gates.resize(_MaxIndex + _OutputNum + 1);
+    _type.assign(_gates.size(), GATE_UNDEF);
+    _fanin0.assign(_gates.size(), -1);
+    _fanin1.assign(_gates.size(), -1);
+    _foBegin.assign(_gates.size(), 0);
+    _foSize.assign(_gates.size(), 0);
+    _foCap.assign(_gates.size(), 0);
+    _foLits.clear();
+    _foDead = 0;
+    _edgePos0.assign(_gates.size(), -1);
+    _edgePos1.assign(_gates.size(), -1);
     _active.resize(_gates.size());
-    _cirVis.resize(_gates.size());
-    _replaced.resize(_gates.size());
+    _cirVis.assign(_gates.size(), 0);
+    _visEpoch = 1;
+    _replaced.assign(_gates.size(), 0);
+    _replaceEpoch = 1;
+    _symOfs.assign(_gates.size(), -1);
     fill(_gates.begin(), _gates.end(), nullptr);
     fill(_active.begin(), _active.end(), false);
 }
+CirMgr::CirMgr()
+    : _simThreads(1),
+      _simByLevel(false),
+      _simSeed(0),
+      _srcHash(0),
+      _pipe(0),
+      _packed(0),
+      _gateMem(new MemMgr<CirGate>(1 << 20)) {}
 CirMgr::~CirMgr() {
-    for (int i = 0; i < _gates.size(); i++)
-        if (_gates[i] != nullptr) delete _gates[i];
+    abortPipeline();
+    delete _packed;
+    delete _gateMem;
 }
@@ -12,8 +12,10 @@
 #include <fstream>
 #include <iostream>
 #include <cstdio>
+#include <stdint.h>
 #include <string>
 #include <list>
+#include <utility>
 #include <vector>
 
 using namespace std;
@@ -29,11 +31,16 @@ inline int toID(int lid) { return lid >> 1; }
 inline int isInv(int lid) { return lid & 1; }
 inline int inv(int val) { return ~val; }
 
-class SimValPar;
+class ThreadPool;
+class BufWriter;
+class CirPipe;
+class CirPackedFanIn;
+template <class T>
+class MemMgr;
 
 class CirMgr {
    public:
-    CirMgr() {}
+    CirMgr();
     ~CirMgr();
     void reset();
 
@@ -42,13 +49,41 @@ class CirMgr {
     CirGate *getGateByLID(int lid) const { return _gates[lid >> 1]; }
     const vector<CirGate *> &getGates() const { return _gates; }
 
-    bool readCircuit(const string &);
+    // Flat AIG core, indexed by gate id: gate type and fanin literals
+    // (-1 if none). Traversals read these instead of the CirGate objects.
+    GateType typeOf(int id) const { return (GateType)_type[id]; }
+    int fanInSize(int id) const {
+        return _type[id] == GATE_AIG ? 2 : _type[id] == GATE_PO ? 1 : 0;
+    }
+    int fanIn(int id, int i) const { return i ? _fanin1[id] : _fanin0[id]; }
+    int fanOutSize(int id) const { return _foSize[id]; }
+    int fanOut(int id, int i) const { return _foLits[_foBegin[id] + i]; }
+
+    bool readCircuit(const string &, int mode = READ_STREAM, int nThreads = 1);
     void sweep();
     void optimize();
+    void compact();
+    bool pack();
+    void unpack();
+    bool isPacked() const { return _packed != 0; }
 
     void randomSim();
-    void fileSim(ifstream &);
+    void fileSim(istream &);
     void setSimLog(ofstream *logFile) { _simLog = logFile; }
+    // Incremental resimulation of the first 64 patterns of the last
+    // simulation: only the fanout cones of PIs whose words change are
+    // evaluated. Returns the gates evaluated, -1 if nothing was simulated.
+    int resimulate(const GateList &idPIs, const vector<uint64_t> &words);
+    bool flipSim(const GateList &idPIs);
+    // n threads simulate separate pattern words, or with byLevel all of
+    // them split the gates of each level of one word
+    void setSimThreads(int n, bool byLevel = false) {
+        _simThreads = n;
+        _simByLevel = byLevel;
+    }
+    // random patterns of the next CIRSIMulate -Random; each run without a
+    // seed of its own takes the one after the last
+    void setSimSeed(uint64_t seed) { _simSeed = seed; }
 
     void strash();
     void printFEC() const;
@@ -62,32 +97,138 @@ class CirMgr {
     void printFECPairs() const;
     void writeAag(ostream &) const;
     void writeGate(ostream &, CirGate *) const;
+    void writeAig(ostream &) const;
+    void writeGateAig(ostream &, CirGate *) const;
+
+    const char *getSymbol(int id) const;
+    bool hasSymbol(int id) const { return *getSymbol(id) != 0; }
+
+    bool saveImage(const string &, int stage) const;
+    bool loadImage(const string &, const string &srcFile, int &stage);
 
     int size() const { return _gates.size(); }
 
    private:
+    bool readCompressed(const string &, int mode, int nThreads);
+    bool readAag(istream &);
+    bool readAig(istream &);
+    bool readAagMmap(const string &, int nThreads);
+    bool parseAag(const char *begin, const char *end, ThreadPool *pool);
+    bool parseAIGs(ThreadPool &pool, const char *begin, const char *end,
+                   int firstLine, const char *&andEnd);
+    void addAIG(int lid, int lid0, int lid1, int line);
+    void startPipeline();
+    bool finishPipeline();
+    void abortPipeline();
+    void linkAIG(int id);
+    void readSymbol(string &);
+    void setIOSymbol(char type, int idx, const string &name) const;
+    void setSymbol(int id, const string &name) const;
+    bool deferSymbols(size_t pos);
+    void loadSymbols() const;
+    void buildConnection(const vector<int> &linePO, ThreadPool *pool = 0);
+    void buildFanOut(ThreadPool &pool);
+    void buildFanOut();
+
     void writeGate(int id) const;
+    void reachableAIGs(GateList &idAIGs, GateList &lidOutputs) const;
+    void writeAig(BufWriter &, const GateList &idInputs,
+                  const GateList &lidOutputs, const GateList &idAIGs) const;
 
     ofstream *_simLog;
+    int _simThreads;
+    bool _simByLevel;
+    uint64_t _simSeed;
+    string _srcFile;
+    uint64_t _srcHash;  // key of the image loaded without a source
+
+    mutable vector<char> _symArena;
+    mutable vector<int> _symOfs;
+    mutable string _symFile;
+    size_t _symPos;
 
     void setHeader(int M, int I, int L, int O, int A);
     void getNotUsed() const;
-    void printNetlist(int id, int &idx) const;
     void getAIGReachability(int id, GateList &aigs) const;
 
-    void sweep(int id);
+    // Active gates reachable from the POs, fanins first. Built on first use
+    // and dropped by anything that rewires or reactivates gates.
+    mutable GateList _dfsList;
+    mutable bool _dfsValid;
+    const GateList &dfsList() const;
+
+    // Iterative DFS over fanins with an explicit stack, so the depth of a
+    // circuit is not limited by the call stack. enter(id) is called when a
+    // gate is reached and returns false if it should not be expanded (seen
+    // before); fanin gate in is reached only if follow(in); leave(id) runs
+    // after all fanins of id are done. Not reentrant: the stack is shared.
+    mutable vector<pair<int, int> > _walkStack;
+    template <class Enter, class Follow, class Leave>
+    void walk(int root, Enter enter, Follow follow, Leave leave) const {
+        if (!enter(root)) return;
+        _walkStack.clear();
+        _walkStack.push_back(make_pair(root, 0));
+        while (!_walkStack.empty()) {
+            int id = _walkStack.back().first;
+            int i = _walkStack.back().second++;
+            if (i < fanInSize(id)) {
+                int in = toID(fanIn(id, i));
+                if (follow(in) && enter(in))
+                    _walkStack.push_back(make_pair(in, 0));
+            } else {
+                _walkStack.pop_back();
+                leave(id);
+            }
+        }
+    }
+
     void sweepNoPrompt();
+    void sweep(GateList &removed);
     void promptRemove(const char* message, int id);
 
     void optimize(int id);
 
     void strash(int id);
-
-    void initSim(vector<SimValPar> &val);
-    void doSim(vector<SimValPar> &val);
+    void strashAIG(int lid, int lid0, int lid1, int line);
+    void strashPending();
+    void hashAIG(int lid, int lid0, int lid1, int line);
+    int strashLit(int lid) const;
+
+    bool _strashOnRead;
+    GateList _strashLit;
+    GateList _strashQueue;
+
+    bool _pipeOnRead;
+    CirPipe *_pipe;
+    GateList _level;
+
+    // Levelized simulation schedule over dfsList(): gates sorted by _level,
+    // level k in _simOps[_simLevelOfs[k] .. _simLevelOfs[k + 1]), so a whole
+    // pass is one branch-free loop. Rebuilt whenever dfsList() is.
+    vector<CirSimOp> _simOps;
+    GateList _simLevelOfs;
+    mutable bool _simOpsValid;
+    const vector<CirSimOp> &simSchedule();
+
+    // Val is SimValPar<N>, the word width simLanes() picked in cirSim.cpp
+    template <class Val>
+    void initSim(vector<Val> &val);
+    template <class Val>
+    void evalSim(vector<vector<Val> > &val, int nb, ThreadPool &pool);
+    template <class Val>
+    void refineFEC(const Val *val);
+    template <class Val>
+    void keepSimWord(const vector<Val> &val);
+    void linkFECGroups();
+
+    // One word per gate for resimulate(), with its level-keyed event queue
+    vector<uint64_t> _simWord;
+    vector<GateList> _simEvents;
+    vector<char> _simQueued;
+    template <class Val>
     void randomSimParallel();
-    void fileSimParallel(ifstream& patternFile);
-    void simulationParallel(vector<SimValPar> &val, int id);
+    template <class Val>
+    void fileSimParallel(istream &patternFile);
 
     void replace(int lidNew, int idOld);
     void optReplace(int lidNew, int idOld);
@@ -95,15 +236,42 @@ class CirMgr {
     void fraigReplace(int lidNew, int idOld);
     
     void promptReplace(const char* message, int lidNew, int idOld);
-    void replaceIn(vector<int> &LFanOut, int lidNew, int idOld);
-    void removeOut(vector<int> &LFanIn, int idOld);
+    int replaceIn(int idOld, int lidNew);
+    void removeOut(int idFrom, int idOld);
 
     list<list<int>> _FECGroupList;
+    // the FEC group of a gate that is in none, so CIRGate prints it as empty
+    static list<list<int>> _noFECGroup;
 
     bool proveFEC(int lid0, int lid1);
     void buildSolver(SatSolver &ss, int id);
 
     GatePointerList _gates;
+    vector<unsigned char> _type;
+    GateList _fanin0;
+    GateList _fanin1;
+
+    // Set by pack(): the fanins live in _packed and _fanin0/1 are empty
+    // until unpack(). Only simulation and whole-circuit CIRWrite read the
+    // packed form (in id order, which pack() checks is topological).
+    CirPackedFanIn *_packed;
+
+    // Fanouts in CSR form: the fanout literals of gate id are
+    // _foLits[_foBegin[id] .. _foBegin[id] + _foSize[id]), in a slice with
+    // room for _foCap[id]. A slice that fills up moves to the end of
+    // _foLits with twice the room; the slots it leaves are tombstones
+    // (_foDead counts them) until compactFanOut() squeezes them out.
+    GateList _foBegin;
+    GateList _foSize;
+    GateList _foCap;
+    GateList _foLits;
+    size_t _foDead;
+
+    // _edgePos0/1[id]: where the edge of fanin slot 0/1 of id sits in the
+    // fanout slice of that fanin (-1 if it is not listed), so an edge is
+    // unlinked or moved without scanning the slice.
+    GateList _edgePos0;
+    GateList _edgePos1;
     mutable vector<bool> _active;
     mutable int _activeAIGCount;
     GateList _LInputs;
@@ -112,30 +280,69 @@ class CirMgr {
     mutable GateList _notUsed;
 
     void getActiveAIGCount() const;
-    void getActiveAIGCount(int id) const;
 
-    GateList &LFanInOf(int id);
-    GateList &LFanOutOf(int id);
+    void initFanOut(const GateList &count);
+    void addFanOut(int id, int lid, int slot);
+    void removeFanOut(int id, int i);
+    void compactFanOut();
+    void indexFanOut(int id);
+    void unlinkFanIn(int id, int i);
+    int fanOutSlot(int id, int i) const;
+    int &fanOutRef(int id, int i) { return _foLits[_foBegin[id] + i]; }
+    int edgePos(int id, int i) const {
+        return i ? _edgePos1[id] : _edgePos0[id];
+    }
+    int &edgePosRef(int id, int i) { return i ? _edgePos1[id] : _edgePos0[id]; }
+
+    // Gates live in blocks of _gateMem and hold no heap memory of their
+    // own, so reset() drops a whole circuit without visiting its gates.
+    MemMgr<CirGate> *_gateMem;
 
     CirGate *gate(int id) { return _gates[id]; }
-    bool isAIG(int id) const;
-    bool isPI(int id) const;
-    bool isPO(int id) const;
-    bool isCONST0(int id) const;
-
-    mutable vector<bool> _cirVis;
-    void resetVisit() const { fill(_cirVis.begin(), _cirVis.end(), false); }
-    void visit(int id) const { _cirVis[id] = true; }
-    bool visited(int id) const { return _cirVis[id]; }
-
-    vector<bool> _replaced;
-    void resetReplace() { fill(_replaced.begin(), _replaced.end(), false); }
-    void replace(int id) { _replaced[id] = true; }
-    bool replaced(int id) const { return _replaced[id]; }
+    CirGate *createGate(GateType type, int id);
+    void setFanIn(int id, int lid0, int lid1 = -1);
+    int &fanInRef(int id, int i) { return i ? _fanin1[id] : _fanin0[id]; }
+    bool isAIG(int id) const { return _type[id] == GATE_AIG; }
+    bool isPI(int id) const { return _type[id] == GATE_PI; }
+    bool isPO(int id) const { return _type[id] == GATE_PO; }
+    bool isCONST0(int id) const { return _type[id] == GATE_CONST0; }
+
+    // A gate is marked when its stamp equals the current epoch, so starting
+    // a traversal only bumps the epoch; the marks are cleared on wrap-around.
+    mutable vector<uint32_t> _cirVis;
+    mutable uint32_t _visEpoch;
+    void resetVisit() const { nextEpoch(_cirVis, _visEpoch); }
+    void visit(int id) const { _cirVis[id] = _visEpoch; }
+    bool visited(int id) const { return _cirVis[id] == _visEpoch; }
+    bool firstVisit(int id) const {
+        return visited(id) ? false : (visit(id), true);
+    }
+
+    vector<uint32_t> _replaced;
+    uint32_t _replaceEpoch;
+    void resetReplace() { nextEpoch(_replaced, _replaceEpoch); }
+    void replace(int id) { _replaced[id] = _replaceEpoch; }
+    bool replaced(int id) const { return _replaced[id] == _replaceEpoch; }
+
+    static void nextEpoch(vector<uint32_t> &mark, uint32_t &epoch) {
+        if (++epoch == 0) {
+            fill(mark.begin(), mark.end(), 0);
+            epoch = 1;
+        }
+    }
     bool active(int id) const { return _active[id]; }
     bool inactive(int id) const { return !_active[id]; }
     void deactivate(int id);
 
+    // Live references: fanin slots of active gates. An AND whose count
+    // drops to zero is dead and is released with the part of its fanin cone
+    // that only it kept alive, so sweep() only has to start from the ANDs
+    // that were unused to begin with.
+    mutable GateList _refCount;
+    mutable GateList _deadAIGs;
+    void countRefs() const;
+    void release(int id, GateList &removed);
+
     int _MaxIndex;
     int _InputNum;
     int _LatchNum;
@@ -6,9 +6,12 @@
   Copyright    [ Copyleft(c) 2008-present LaDs(III), GIEE, NTU, Taiwan ]
 ****************************************************************************/
 
+#include <algorithm>
 #include <cassert>
 #include "cirGate.h"
 #include "cirMgr.h"
+#include "cirPack.h"
+#include "memMgr.h"
 #include "util.h"
 
 using namespace std;
@@ -40,74 +43,204 @@ void CirMgr::promptReplace(const char* message, int lidNew, int idOld) {
 }
 
 void CirMgr::sweep() {
-    resetVisit();
-    for (int i = 0; i < _LOutputs.size(); i++)
-        sweep(toID(_LOutputs[i]));
-    for (int i = 0; i < _LAIGs.size(); i++) {
-        int id = toID(_LAIGs[i]);
-        if (!visited(id) && active(id)) {
-            promptRemove("Sweeping: ", id);
-            deactivate(id);
-            removeOut(LFanInOf(id), id);
-        }
-    }
+    GateList removed;
+    sweep(removed);
+    sort(removed.begin(), removed.end());
+    for (int i = 0; i < removed.size(); i++)
+        promptRemove("Sweeping: ", removed[i]);
 }
 
 void CirMgr::sweepNoPrompt() {
-    resetVisit();
-    for (int i = 0; i < _LOutputs.size(); i++)
-        sweep(toID(_LOutputs[i]));
-    for (int i = 0; i < _LAIGs.size(); i++) {
-        int id = toID(_LAIGs[i]);
-        if (!visited(id) && active(id)) {
-            deactivate(id);
-            removeOut(LFanInOf(id), id);
-        }
+    GateList removed;
+    sweep(removed);
+}
+
+// Dead logic is released as soon as it loses its last reference, so only
+// the ANDs that were never used (and their cones) are left to remove here.
+void CirMgr::sweep(GateList& removed) {
+    for (int i = 0; i < _deadAIGs.size(); i++) {
+        int id = _deadAIGs[i];
+        if (!active(id) || _refCount[id] != 0) continue;
+        removed.push_back(id);
+        removeOut(id, id);
+        release(id, removed);
     }
+    _deadAIGs.clear();
 }
-// Recursively simplifying from POs;
+// Simplifying from POs in DFS order; a gate is only replaced by one of
+// its fanins (or CONST0), which come earlier in the order.
 // _dfsList needs to be reconstructed afterwards
 // UNDEF gates may be delete if its fanout becomes empty...
 void CirMgr::optimize() {
+    GateList dfs = dfsList();
+    for (int i = 0; i < dfs.size(); i++)
+        optimize(dfs[i]);
+}
+
+// Renumber the gates that are still alive: CONST0, the PIs in input order,
+// the ANDs fanins first (those reaching a PO in DFS order, then the rest),
+// the ids only referenced as (undefined) fanins, then the POs. All per-gate
+// arrays are rebuilt in the new numbering, the gates move to a fresh arena
+// and the dead ones are freed with the old one. Names and FEC groups stay.
+void CirMgr::compact() {
+    int n = _gates.size();
+    GateList newID(n, -1), order;
+    auto take = [&](int id) {
+        newID[id] = order.size();
+        order.push_back(id);
+    };
+    take(0);
+    for (int i = 0; i < _LInputs.size(); i++)
+        take(toID(_LInputs[i]));
+
+    const GateList& dfs = dfsList();
     resetVisit();
+    for (int i = 0; i < dfs.size(); i++)
+        visit(dfs[i]);
+    for (int i = 0; i < dfs.size(); i++)
+        if (isAIG(dfs[i])) take(dfs[i]);
+    for (int i = 0; i < _LAIGs.size(); i++) {
+        int id = toID(_LAIGs[i]);
+        if (!active(id)) continue;
+        walk(id, [this](int id) { return firstVisit(id); },
+             [this](int in) { return active(in); },
+             [&](int id) {
+                 if (isAIG(id)) take(id);
+             });
+    }
+    int nAIG = order.size() - 1 - _LInputs.size();
+    for (int i = 1 + _LInputs.size(), last = order.size(); i < last; i++)
+        for (int j = 0; j < fanInSize(order[i]); j++)
+            if (newID[toID(fanIn(order[i], j))] < 0)
+                take(toID(fanIn(order[i], j)));
+    for (int id = _MaxIndex + 1; id < n; id++)
+        if (newID[toID(_fanin0[id])] < 0) take(toID(_fanin0[id]));
+    int M = order.size() - 1;
+    for (int id = _MaxIndex + 1; id < n; id++)
+        take(id);
+
+    GatePointerList gates;
+    vector<unsigned char> type;
+    GateList fanin0, fanin1, symOfs;
+    vector<bool> active;
+    gates.swap(_gates);
+    type.swap(_type);
+    fanin0.swap(_fanin0);
+    fanin1.swap(_fanin1);
+    symOfs.swap(_symOfs);
+    active.swap(_active);
+    MemMgr<CirGate>* mem = _gateMem;
+    _gateMem = new MemMgr<CirGate>(1 << 20);
+    setHeader(M, _InputNum, _LatchNum, _OutputNum, nAIG);
+
+    auto newLit = [&](int lid) {
+        return lid < 0 ? lid : toLID(newID[toID(lid)], lid);
+    };
+    for (int id = 0; id < order.size(); id++) {
+        int old = order[id];
+        _symOfs[id] = symOfs[old];
+        CirGate* g = gates[old];
+        // an AND that is referenced but dead becomes UNDEF
+        if (g == nullptr || (type[old] == GATE_AIG && !active[old])) continue;
+        CirGate* gate = createGate(GateType(type[old]), id);
+        gate->setLineNo(g->lineNo());
+        gate->_simVal = g->_simVal;
+        gate->_FECGroupIt = g->_FECGroupIt;
+        gate->_FECInv = g->_FECInv;
+        _active[id] = active[old];
+        setFanIn(id, newLit(fanin0[old]), newLit(fanin1[old]));
+    }
+    delete mem;
+
+    for (int i = 0; i < _LInputs.size(); i++)
+        _LInputs[i] = toLID(newID[toID(_LInputs[i])]);
     for (int i = 0; i < _LOutputs.size(); i++)
-        optimize(toID(_LOutputs[i]));
+        _LOutputs[i] = toLID(M + 1 + i);
+    _LAIGs.clear();
+    for (int id = 1 + _InputNum; id <= _InputNum + nAIG; id++)
+        _LAIGs.push_back(toLID(id));
+    for (auto& FECGroup : _FECGroupList) {
+        for (auto it = FECGroup.begin(); it != FECGroup.end();) {
+            int id = newID[toID(*it)];
+            if (id < 0 || _gates[id] == nullptr) {
+                it = FECGroup.erase(it);
+            } else {
+                *it = toLID(id, *it);
+                ++it;
+            }
+        }
+    }
+    _notUsed.clear();
+    _level.clear();
+    _simWord.clear();
+    _dfsList.clear();
+    _dfsValid = false;
+    buildFanOut();
+    countRefs();
 }
 
-/***************************************************/
-/*   Private member functions about optimization   */
-/***************************************************/
-void CirMgr::sweep(int id) {
-    if (visited(id)) return;
-    visit(id);
-
-    vector<int>& LFanIn = LFanInOf(id);
-    for (int i = 0; i < LFanIn.size(); i++) {
-        int id = toID(LFanIn[i]);
-        if (active(id)) sweep(id);
+// Swap the flat fanin arrays for a CirPackedFanIn. The unused ANDs are swept
+// first, so the live gates are exactly the active ones and simulation can
+// evaluate them straight off the stream in id order.
+bool CirMgr::pack() {
+    if (_packed) return true;
+    int n = _gates.size();
+    for (int id = 1; id < n; id++) {
+        if (!active(id)) continue;
+        for (int i = 0; i < fanInSize(id); i++) {
+            int in = toID(fanIn(id, i));
+            if (in >= id && _gates[in] != nullptr) {
+                cerr << "Error: gates are not in topological order; "
+                     << "run CIRCompact first!!" << endl;
+                return false;
+            }
+        }
     }
-}
+    sweepNoPrompt();
 
-void CirMgr::optimize(int id) {
-    if (visited(id)) return;
-    visit(id);
+    _packed = new CirPackedFanIn;
+    for (int id = 1; id < n; id++)
+        if (fanInSize(id))
+            _packed->push(id, _fanin0[id], isAIG(id) ? _fanin1[id] : -1);
+    _packed->shrink();
+    size_t flat = (_fanin0.capacity() + _fanin1.capacity()) * sizeof(int);
+    GateList().swap(_fanin0);
+    GateList().swap(_fanin1);
+    GateList().swap(_dfsList);
+    _dfsValid = false;
+    vector<CirSimOp>().swap(_simOps);
+    _simOpsValid = false;
+    printf("Packed fanins: %.2f bytes/gate (flat: %.2f bytes/gate)\n",
+           (double)_packed->bytes() / n, (double)flat / n);
+    return true;
+}
 
-    vector<int>& LFanIn = LFanInOf(id);
-    for (int i = 0; i < LFanIn.size(); i++) {
-        int id = toID(LFanIn[i]);
-        if (active(id)) optimize(id);
-    }
+void CirMgr::unpack() {
+    if (!_packed) return;
+    int n = _gates.size(), id, lid0, lid1;
+    _fanin0.assign(n, -1);
+    _fanin1.assign(n, -1);
+    CirPackedFanIn::Reader r(*_packed);
+    while (r.next(id, lid0, lid1)) setFanIn(id, lid0, lid1);
+    delete _packed;
+    _packed = 0;
+}
 
+/***************************************************/
+/*   Private member functions about optimization   */
+/***************************************************/
+void CirMgr::optimize(int id) {
     if (isAIG(id)) {
-        if (LFanIn[0] == 1)
-            optReplace(LFanIn[1], id);
-        else if (LFanIn[1] == 1)
-            optReplace(LFanIn[0], id);
-        else if (LFanIn[0] == 0 || LFanIn[1] == 0)
+        int lid0 = _fanin0[id], lid1 = _fanin1[id];
+        if (lid0 == 1)
+            optReplace(lid1, id);
+        else if (lid1 == 1)
+            optReplace(lid0, id);
+        else if (lid0 == 0 || lid1 == 0)
             optReplace(0, id);
-        else if (LFanIn[0] == LFanIn[1])
-            optReplace(LFanIn[0], id);
-        else if (toID(LFanIn[0]) == toID(LFanIn[1]))
+        else if (lid0 == lid1)
+            optReplace(lid0, id);
+        else if (toID(lid0) == toID(lid1))
             optReplace(0, id);
     }
 }
@@ -118,51 +251,47 @@ void CirMgr::optReplace(int lidNew, int idOld) {
 }
 
 void CirMgr::replace(int lidNew, int idOld) {
-    GateList& LFanOutOld = LFanOutOf(idOld);
     int idNew = toID(lidNew);
-    GateList& LFanInNew = LFanInOf(idNew);
-    GateList& LFanOutNew = LFanOutOf(idNew);
-    replaceIn(LFanOutOld, lidNew, idOld);
-    removeOut(LFanInNew, idOld);
-
-    if (isInv(lidNew)) {
-        for (int i = 0; i < LFanOutOld.size(); i++)
-            LFanOutOld[i] ^= 1;
-    }
-    LFanOutNew.insert(LFanOutNew.end(), LFanOutOld.begin(), LFanOutOld.end());
-    deactivate(idOld);
+    int moved = replaceIn(idOld, lidNew);
+    _refCount[idNew] += moved;
+    _refCount[idOld] -= moved;
+    removeOut(idNew, idOld);
+    _dfsValid = false;
+
+    GateList removed;
+    if (active(idOld))
+        release(idOld, removed);
+    else
+        deactivate(idOld);
 }
 
-void CirMgr::replaceIn(vector<int>& LFanOut, int lidNew, int idOld) {
-    for (int i = 0; i < LFanOut.size(); i++) {
-        int id = toID(LFanOut[i]);
-        for (int j = 0; j < LFanInOf(id).size(); j++) {
-            if (toID(LFanInOf(id)[j]) == idOld) {
-                if (isInv(LFanInOf(id)[j]))
-                    LFanInOf(id)[j] = lidNew ^ 1;
-                else
-                    LFanInOf(id)[j] = lidNew;
-            }
-        }
+// Point the fanouts of idOld at lidNew and append their edges to the slice
+// of idNew; idOld keeps its (now stale) list. Each edge knows its fanin
+// slot, so the cost is one step per fanout. Returns the number of fanin
+// slots of active gates moved over.
+int CirMgr::replaceIn(int idOld, int lidNew) {
+    int idNew = toID(lidNew), moved = 0;
+    for (int i = 0; i < fanOutSize(idOld); i++) {
+        int lid = fanOut(idOld, i) ^ isInv(lidNew), id = toID(lid);
+        int slot = fanOutSlot(idOld, i);
+        fanOutRef(idOld, i) = lid;
+        if (slot < 0) continue;
+        fanInRef(id, slot) = lidNew ^ isInv(fanIn(id, slot));
+        addFanOut(idNew, lid, slot);
+        if (active(id)) ++moved;
     }
+    return moved;
 }
 
-void CirMgr::removeOut(vector<int>& LFanIn, int idOld) {
-    for (int i = 0; i < LFanIn.size(); i++) {
-        int id = toID(LFanIn[i]);
-        GateList& LFanOutOfID = LFanOutOf(id);
-
-        int thisIsACounterToOptimizeThisFunctionBecauseItCantBeGreaterThan2 = 0;
-        for (int j = 0; j < LFanOutOfID.size(); j++) {
-            if (toID(LFanOutOfID[j]) == idOld) {
-                LFanOutOfID[j] = LFanOutOfID.back();
-                LFanOutOfID.pop_back();
-                --j;
-                ++thisIsACounterToOptimizeThisFunctionBecauseItCantBeGreaterThan2;
-            }
-            if (thisIsACounterToOptimizeThisFunctionBecauseItCantBeGreaterThan2 ==
-                2)
+// drop the edges from idOld to the fanins it shares with idFrom
+void CirMgr::removeOut(int idFrom, int idOld) {
+    for (int i = 0; i < fanInSize(idOld); i++) {
+        int in = toID(fanIn(idOld, i));
+        for (int j = 0; j < fanInSize(idFrom); j++) {
+            if (toID(fanIn(idFrom, j)) == in) {
+                unlinkFanIn(idOld, i);
                 break;
+            }
         }
     }
 }
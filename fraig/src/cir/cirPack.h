@@ -0,0 +1,90 @@
+/****************************************************************************
+  FileName     [ cirPack.h ]
+  PackageName  [ cir ]
+  Synopsis     [ Define varint-packed storage for gate fanins ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2008-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+
+#ifndef CIR_PACK_H
+#define CIR_PACK_H
+
+#include <vector>
+
+using namespace std;
+
+// CirPackedFanIn keeps the fanins of the ANDs and POs in one byte array,
+// gate by gate in ascending id order. Like the AND section of a binary
+// AIGER file, every number is a delta stored as a varint:
+//    (id - previous id) << 1 | isPO,
+//    zigzag(2 * id - lid0),
+//    zigzag(lid0 - lid1)            (ANDs only)
+// Once CIRCompact has put every fanin just below its gate, most of these
+// fit in one byte each. The deltas are zigzag-coded so that any order and
+// either fanin order can still be stored. There is no random access: the
+// fanins are read back in order through a Reader.
+class CirPackedFanIn {
+   public:
+    CirPackedFanIn() : _lastId(0), _size(0) {}
+
+    // ids must be pushed in ascending order; lid1 < 0 marks a PO
+    void push(int id, int lid0, int lid1) {
+        putVarint((unsigned)(id - _lastId) << 1 | (lid1 < 0));
+        putVarint(zigzag(2 * id - lid0));
+        if (lid1 >= 0) putVarint(zigzag(lid0 - lid1));
+        _lastId = id;
+        ++_size;
+    }
+    void shrink() { vector<unsigned char>(_bytes).swap(_bytes); }
+
+    size_t size() const { return _size; }
+    size_t bytes() const { return _bytes.capacity(); }
+
+    class Reader {
+       public:
+        Reader(const CirPackedFanIn& p)
+            : _p(p._bytes.data()), _end(_p + p._bytes.size()), _id(0) {}
+
+        // the next gate; lid1 is -1 for a PO
+        bool next(int& id, int& lid0, int& lid1) {
+            if (_p == _end) return false;
+            unsigned head = getVarint();
+            id = _id += head >> 1;
+            lid0 = 2 * id - unzigzag(getVarint());
+            lid1 = (head & 1) ? -1 : lid0 - unzigzag(getVarint());
+            return true;
+        }
+
+       private:
+        unsigned getVarint() {
+            unsigned v = 0;
+            for (int shift = 0;; shift += 7) {
+                unsigned char c = *_p++;
+                v |= (unsigned)(c & 0x7f) << shift;
+                if (!(c & 0x80)) return v;
+            }
+        }
+
+        const unsigned char* _p;
+        const unsigned char* _end;
+        int _id;
+    };
+
+   private:
+    static unsigned zigzag(int v) { return ((unsigned)v << 1) ^ -(v < 0); }
+    static int unzigzag(unsigned v) { return (int)(v >> 1) ^ -(int)(v & 1); }
+
+    void putVarint(unsigned v) {
+        while (v & ~0x7fu) {
+            _bytes.push_back((v & 0x7f) | 0x80);
+            v >>= 7;
+        }
+        _bytes.push_back(v);
+    }
+
+    vector<unsigned char> _bytes;
+    int _lastId;
+    size_t _size;
+};
+
+#endif  // CIR_PACK_H
@@ -10,13 +10,19 @@
 #include <cassert>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <list>
+#include <stdint.h>
 #include "cirGate.h"
 #include "cirMgr.h"
+#include "cirPack.h"
 #include "myHashMap.h"
+#include "myRandom.h"
+#include "myThreadPool.h"
+#include "myWriter.h"
 #include "util.h"
 
 using namespace std;
@@ -32,71 +38,222 @@ using namespace std;
 /*   Static varaibles and functions   */
 /**************************************/
 
-static int setMaskInv[32] = {
-    ~(1 << 0),  ~(1 << 1),  ~(1 << 2),  ~(1 << 3),  ~(1 << 4),  ~(1 << 5),
-    ~(1 << 6),  ~(1 << 7),  ~(1 << 8),  ~(1 << 9),  ~(1 << 10), ~(1 << 11),
-    ~(1 << 12), ~(1 << 13), ~(1 << 14), ~(1 << 15), ~(1 << 16), ~(1 << 17),
-    ~(1 << 18), ~(1 << 19), ~(1 << 20), ~(1 << 21), ~(1 << 22), ~(1 << 23),
-    ~(1 << 24), ~(1 << 25), ~(1 << 26), ~(1 << 27), ~(1 << 28), ~(1 << 29),
-    ~(1 << 30), ~(1 << 31)};
-static int setMask[32] = {
-    1 << 0,  1 << 1,  1 << 2,  1 << 3,  1 << 4,  1 << 5,  1 << 6,  1 << 7,
-    1 << 8,  1 << 9,  1 << 10, 1 << 11, 1 << 12, 1 << 13, 1 << 14, 1 << 15,
-    1 << 16, 1 << 17, 1 << 18, 1 << 19, 1 << 20, 1 << 21, 1 << 22, 1 << 23,
-    1 << 24, 1 << 25, 1 << 26, 1 << 27, 1 << 28, 1 << 29, 1 << 30, 1 << 31};
-
+#if defined(__GNUC__)
+#define SIM_INLINE inline __attribute__((always_inline))
+#else
+#define SIM_INLINE inline
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIM_X86
+#define SIM_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// SimValPar<N> holds the values of one gate under 64 * N patterns, pattern
+// i in bit i % 64 of word i / 64. The 64-bit (N = 1), AVX2 (N = 4) and
+// AVX-512 (N = 8) widths are all compiled in; simLanes() picks the widest
+// one the CPU runs, so one pass over the circuit covers up to 512 patterns.
+template <int N>
 class SimValPar {
    public:
-    typedef int32_t par_type;
-    const static par_type mask = 0xffffffff;
+    enum { BITS = 64 * N };
 
-    SimValPar(par_type _v = 0) : v(_v) {}
+    SimValPar() { clear(); }
+    void clear() {
+        for (int k = 0; k < N; ++k) v[k] = 0;
+    }
+    void set(size_t i) { v[i >> 6] |= (uint64_t)1 << (i & 63); }
     void set(size_t i, bool b) {
-        if (b)
-            v |= setMask[i];
-        else
-            v &= setMaskInv[i];
+        uint64_t m = (uint64_t)1 << (i & 63);
+        v[i >> 6] = b ? v[i >> 6] | m : v[i >> 6] & ~m;
     }
+    bool operator[](size_t i) const { return (v[i >> 6] >> (i & 63)) & 1; }
 
-    bool operator[](size_t i) const { return v & (setMask[i]); }
-
-    size_t operator()() const { return v ^ (v << 1); }
-    par_type v;
+    size_t operator()() const {
+        uint64_t h = 0;
+        for (int k = 0; k < N; ++k) h = (h ^ v[k]) * 0x9e3779b97f4a7c15ULL;
+        return h ^ (h >> 32);
+    }
+    SimValPar operator~() const {
+        SimValPar r;
+        for (int k = 0; k < N; ++k) r.v[k] = ~v[k];
+        return r;
+    }
+    bool operator==(const SimValPar& rhs) const {
+        for (int k = 0; k < N; ++k)
+            if (v[k] != rhs.v[k]) return false;
+        return true;
+    }
 
-    void push_back(bool b) {}
-    size_t size() { return 32; }
-    size_t sizeOfv() { return 1; }
-    bool operator==(const SimValPar& rhs) const { return v == rhs.v; }
+    uint64_t v[N];
 };
 
+// 64-bit lanes per simulation word: 8 with AVX-512, 4 with AVX2, else 1
+static int simLanes() {
+#ifdef SIM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return 8;
+    if (__builtin_cpu_supports("avx2")) return 4;
+#endif
+    return 1;
+}
+
+template <int N>
+static SIM_INLINE void simGate(SimValPar<N>* val, int id, int type, int lid0,
+                               int lid1) {
+    typedef uint64_t Word __attribute__((vector_size(8 * N)));
+    Word a, b;
+    if (type == GATE_AIG) {
+        memcpy(&a, val[lid0 >> 1].v, sizeof(a));
+        memcpy(&b, val[lid1 >> 1].v, sizeof(b));
+        a = (a ^ -(uint64_t)(lid0 & 1)) & (b ^ -(uint64_t)(lid1 & 1));
+    } else if (type == GATE_PO) {
+        memcpy(&a, val[lid0 >> 1].v, sizeof(a));
+        a ^= -(uint64_t)(lid0 & 1);
+    } else {
+        return;
+    }
+    memcpy(val[id].v, &a, sizeof(a));
+}
+
+// Evaluate the schedule records op[0 .. n) in turn; no branch per gate.
+// The wide instantiations go through the entry points below, which inline
+// this loop into code built for their own instruction set.
+template <int N>
+static SIM_INLINE void simOps(SimValPar<N>* val, const CirSimOp* op,
+                              size_t n) {
+    typedef uint64_t Word __attribute__((vector_size(8 * N)));
+    for (size_t i = 0; i < n; ++i) {
+        Word a, b;
+        memcpy(&a, val[op[i].lid0 >> 1].v, sizeof(a));
+        memcpy(&b, val[op[i].lid1 >> 1].v, sizeof(b));
+        a = (a ^ -(uint64_t)(op[i].lid0 & 1)) &
+            (b ^ -(uint64_t)(op[i].lid1 & 1));
+        memcpy(val[op[i].out].v, &a, sizeof(a));
+    }
+}
+
+#ifdef SIM_X86
+SIM_TARGET("avx2")
+static void simOps(SimValPar<4>* val, const CirSimOp* op, size_t n) {
+    simOps<4>(val, op, n);
+}
+SIM_TARGET("avx512f")
+static void simOps(SimValPar<8>* val, const CirSimOp* op, size_t n) {
+    simOps<8>(val, op, n);
+}
+#endif
+
 /************************************************/
 /*   Public member functions about Simulation   */
 /************************************************/
 
-static HashMap<SimValPar, int> FECMapPar;
-
 void CirMgr::randomSim() {
     sweepNoPrompt();
-    randomSimParallel();
+    switch (simLanes()) {
+        case 8: randomSimParallel<SimValPar<8> >(); break;
+        case 4: randomSimParallel<SimValPar<4> >(); break;
+        default: randomSimParallel<SimValPar<1> >(); break;
+    }
 }
 
-void CirMgr::fileSim(ifstream& patternFile) {
+void CirMgr::fileSim(istream& patternFile) {
     sweepNoPrompt();
-    fileSimParallel(patternFile);
+    switch (simLanes()) {
+        case 8: fileSimParallel<SimValPar<8> >(patternFile); break;
+        case 4: fileSimParallel<SimValPar<4> >(patternFile); break;
+        default: fileSimParallel<SimValPar<1> >(patternFile); break;
+    }
+}
+
+// Give the PIs idPIs[i] the words words[i] and propagate the change through
+// their fanout cones only: a gate is queued at its level when a fanin word
+// changes, and the levels are drained in increasing order, so each gate is
+// evaluated at most once. Returns the number of gates evaluated, or -1 if
+// no simulation has been kept.
+int CirMgr::resimulate(const GateList& idPIs, const vector<uint64_t>& words) {
+    if (_simWord.empty()) return -1;
+    unpack();
+    simSchedule();
+    if (_simEvents.size() < _simLevelOfs.size())
+        _simEvents.resize(_simLevelOfs.size());
+
+    size_t lo = _simEvents.size();
+    auto update = [&](int id, uint64_t w) {
+        if (_simWord[id] == w) return;
+        _simWord[id] = w;
+        for (int i = 0; i < _gates[id]->_simVal.size(); i++)
+            _gates[id]->_simVal[i] = (w >> i) & 1;
+        for (int i = 0; i < fanOutSize(id); i++) {
+            int out = toID(fanOut(id, i));
+            if (!active(out) || _simQueued[out]) continue;
+            _simQueued[out] = true;
+            _simEvents[_level[out]].push_back(out);
+            lo = min(lo, (size_t)_level[out]);
+        }
+    };
+    auto word = [&](int lid) {
+        return _simWord[toID(lid)] ^ -(uint64_t)(lid & 1);
+    };
+
+    for (size_t i = 0; i < idPIs.size(); i++) update(idPIs[i], words[i]);
+    int evaluated = 0;
+    for (size_t k = lo; k < _simEvents.size(); k++) {
+        // fanouts sit on higher levels, so this level does not grow
+        GateList& events = _simEvents[k];
+        for (size_t j = 0; j < events.size(); j++) {
+            int id = events[j];
+            _simQueued[id] = false;
+            ++evaluated;
+            uint64_t w = word(_fanin0[id]);
+            if (isAIG(id)) w &= word(_fanin1[id]);
+            update(id, w);
+        }
+        events.clear();
+    }
+    return evaluated;
+}
+
+// Flip the PIs idPIs in the 64 kept patterns, resimulate, and refine the
+// FEC groups with the new patterns
+bool CirMgr::flipSim(const GateList& idPIs) {
+    for (int id : idPIs) {
+        if (id <= 0 || id >= _gates.size() || typeOf(id) != GATE_PI) {
+            cerr << "Error: gate " << id << " is not a PI!!" << endl;
+            return false;
+        }
+    }
+    vector<uint64_t> words(idPIs.size());
+    for (size_t i = 0; i < idPIs.size() && i < _simWord.size(); i++)
+        words[i] = ~_simWord[idPIs[i]];
+    int evaluated = resimulate(idPIs, words);
+    if (evaluated < 0) {
+        cerr << "Error: no simulated patterns to flip!!" << endl;
+        return false;
+    }
+
+    vector<SimValPar<1> > val(_simWord.size());
+    for (size_t id = 0; id < val.size(); id++) val[id].v[0] = _simWord[id];
+    refineFEC(val.data());
+    linkFECGroups();
+    cout << "64 patterns simulated (" << evaluated << " of " << _simOps.size()
+         << " gates evaluated).\n";
+    return true;
 }
 
 /*************************************************/
 /*   Private member functions about Simulation   */
 /*************************************************/
 
-void CirMgr::initSim(vector<SimValPar>& val) {
-    val[0].v = 0;
+template <class Val>
+void CirMgr::initSim(vector<Val>& val) {
+    _simWord.clear();
+    val[0].clear();
     for (int i = 0; i < _LAIGs.size(); i++)
-        if (active(toID(_LAIGs[i]))) val[toID(_LAIGs[i])].v = 0;
+        if (active(toID(_LAIGs[i]))) val[toID(_LAIGs[i])].clear();
     for (int i = 0; i < _LOutputs.size(); i++)
-        val[toID(_LOutputs[i])].v = 0;
+        val[toID(_LOutputs[i])].clear();
     for (int i = 0; i < _LInputs.size(); i++)
-        val[toID(_LInputs[i])].v = 0;
+        val[toID(_LInputs[i])].clear();
     _FECGroupList.clear();
     _FECGroupList.push_back(list<int>());
     list<int>& list0 = *_FECGroupList.begin();
@@ -105,148 +262,223 @@ void CirMgr::initSim(vector<SimValPar>& val) {
         if (active(toID(_LAIGs[i]))) list0.push_back(_LAIGs[i]);
 }
 
-void writeSimValToGate(vector<SimValPar>& val, CirGate* gate, int id) {
-    for (int i = 0; i < val[id].size(); i++)
+// Levelize dfsList() into _simOps: _level[id] is 0 for a PI or the constant
+// and one more than its deepest fanin otherwise, and a counting sort on it
+// keeps each level in DFS order.
+const vector<CirSimOp>& CirMgr::simSchedule() {
+    const GateList& dfs = dfsList();
+    if (_simOpsValid) return _simOps;
+
+    _level.assign(_gates.size(), 0);
+    int depth = 0;
+    for (int id : dfs) {
+        for (int i = 0; i < fanInSize(id); i++)
+            _level[id] = max(_level[id], _level[toID(fanIn(id, i))] + 1);
+        depth = max(depth, _level[id]);
+    }
+    _simLevelOfs.assign(depth + 2, 0);
+    for (int id : dfs)
+        if (fanInSize(id)) ++_simLevelOfs[_level[id] + 1];
+    for (int k = 1; k <= depth + 1; k++)
+        _simLevelOfs[k] += _simLevelOfs[k - 1];
+
+    GateList next(_simLevelOfs.begin(), _simLevelOfs.end() - 1);
+    _simOps.resize(_simLevelOfs.back());
+    for (int id : dfs) {
+        if (!fanInSize(id)) continue;
+        CirSimOp& op = _simOps[next[_level[id]]++];
+        op.out = id;
+        op.lid0 = _fanin0[id];
+        op.lid1 = isAIG(id) ? _fanin1[id] : 1;
+    }
+    // a gate off the schedule (e.g. a dangling AND) stays queued for good,
+    // so resimulate() never picks it up at a level it was not given
+    _simQueued.assign(_gates.size(), 1);
+    for (const CirSimOp& op : _simOps) _simQueued[op.out] = 0;
+    _simOpsValid = true;
+    return _simOps;
+}
+
+// a gate keeps the values of the first 32 patterns of a word
+template <class Val>
+static void writeSimValToGate(vector<Val>& val, CirGate* gate, int id) {
+    for (int i = 0; i < gate->_simVal.size(); i++)
         gate->_simVal[i] = val[id][i];
 }
 
-void CirMgr::fileSimParallel(ifstream& patternFile) {
-    vector<SimValPar> val(size() + _LOutputs.size() + 1);
-    initSim(val);
+// the first 64 patterns of a word, kept for resimulate()
+template <class Val>
+void CirMgr::keepSimWord(const vector<Val>& val) {
+    _simWord.resize(val.size());
+    for (size_t id = 0; id < val.size(); id++)
+        _simWord[id] = val[id].v[0];
+}
+
+void CirMgr::linkFECGroups() {
+    _FECGroupList.sort();
+    for (CirGate* gate : _gates)
+        if (gate) gate->_FECGroupIt = _noFECGroup.begin();
+    for (auto it = _FECGroupList.begin(); it != _FECGroupList.end(); ++it) {
+        auto& FECGroup = *it;
+        for (int lid : FECGroup) {
+            int id = toID(lid);
+            _gates[id]->_FECGroupIt = it;
+            _gates[id]->_FECInv = isInv(lid);
+        }
+    }
+}
+
+// Evaluate words val[0 .. nb). With pattern blocks each thread takes whole
+// words of its own; in level mode (nb == 1) the threads split every level
+// that is wide enough to pay for the barrier at its end.
+template <class Val>
+void CirMgr::evalSim(vector<vector<Val> >& val, int nb, ThreadPool& pool) {
+    if (_packed) {
+        pool.run([&](size_t t) {
+            for (size_t b = t; b < nb; b += pool.size()) {
+                CirPackedFanIn::Reader r(*_packed);
+                int id, lid0, lid1;
+                while (r.next(id, lid0, lid1))
+                    if (active(id))
+                        simGate(val[b].data(), id, _type[id], lid0, lid1);
+            }
+        });
+        return;
+    }
+    const vector<CirSimOp>& ops = simSchedule();
+    if (!_simByLevel || pool.size() == 1) {
+        pool.run([&](size_t t) {
+            for (size_t b = t; b < nb; b += pool.size())
+                simOps(val[b].data(), ops.data(), ops.size());
+        });
+        return;
+    }
+    const size_t grain = 1024;
+    Val* v = val[0].data();
+    for (size_t k = 0; k + 1 < _simLevelOfs.size(); k++) {
+        const CirSimOp* op = ops.data() + _simLevelOfs[k];
+        size_t n = _simLevelOfs[k + 1] - _simLevelOfs[k];
+        if (n < grain * pool.size())
+            simOps(v, op, n);
+        else
+            pool.parallelFor(n, [&](size_t b, size_t e) {
+                simOps(v, op + b, e - b);
+            });
+    }
+}
+
+// Words are filled in turn and simulated _simThreads at a time, then
+// refined in fill order, so the FEC groups do not depend on the thread
+// count. A new word starts from the inputs of the one filled before it:
+// like one reused word, the lanes a short last word leaves unset repeat
+// earlier patterns.
+template <class Val>
+void CirMgr::fileSimParallel(istream& patternFile) {
+    const int W = Val::BITS;
+    ThreadPool pool(_simThreads);
+    int nBlocks = _simByLevel ? 1 : pool.size();
+    vector<vector<Val> > val(nBlocks,
+                             vector<Val>(size() + _LOutputs.size() + 1));
+    initSim(val[0]);
 
     vector<vector<bool>> valPI(_LInputs.size());
     vector<vector<bool>> valPO(_LOutputs.size());
 
-    int T = 0, Tmod32 = 0;
-    string in[32];
+    int T = 0, Tmod = 0, b = 0, writeAt = -1, last = -1;
+    string in;
 
     bool wrote = false;
-
-        while (patternFile >> in[Tmod32]) {
-        ++T, ++Tmod32;
-        if (Tmod32 == 32) {
-            Tmod32 = 0;
-            for (int i = 0; i < _LInputs.size(); i++) {
-                int id = toID(_LInputs[i]);
-                val[id].v = 0;
-                for (int j = 0; j < 32; j++)
-                    if (in[j][i] == '1') val[id].v |= setMask[j];
-            }
-            doSim(val);
+    auto writeGates = [&](vector<Val>& val) {
+        for (int i = 0; i < _LAIGs.size(); i++) {
+            int id = toID(_LAIGs[i]);
+            if (active(id)) writeSimValToGate(val, _gates[id], id);
+        }
+        for (int i = 0; i < _LInputs.size(); i++) {
+            int id = toID(_LInputs[i]);
+            writeSimValToGate(val, _gates[id], id);
+        }
+        for (int i = 0; i < _LOutputs.size(); i++) {
+            int id = toID(_LOutputs[i]);
+            writeSimValToGate(val, _gates[id], id);
+        }
+        keepSimWord(val);
+    };
+    auto simulate = [&](int nb) {
+        evalSim(val, nb, pool);
+        for (int k = 0; k < nb; k++) {
+            refineFEC(val[k].data());
             if (_simLog) {
-                for (int i = 0; i < 32; i++) {
+                for (int i = 0; i < W; i++) {
                     for (int j = 0; j < _LInputs.size(); j++)
-                        valPI[j].push_back(val[toID(_LInputs[j])][i]);
+                        valPI[j].push_back(val[k][toID(_LInputs[j])][i]);
                     for (int j = 0; j < _LOutputs.size(); j++)
-                        valPO[j].push_back(val[toID(_LOutputs[j])][i]);
+                        valPO[j].push_back(val[k][toID(_LOutputs[j])][i]);
                 }
             }
-
-            if (T == 32) {
-                wrote = true;
-                for (int i = 0; i < _LAIGs.size(); i++) {
-                    int id = toID(_LAIGs[i]);
-                    if (active(id)) writeSimValToGate(val, _gates[id], id);
-                }
-                for (int i = 0; i < _LInputs.size(); i++) {
-                    int id = toID(_LInputs[i]);
-                    writeSimValToGate(val, _gates[id], id);
-                }
-                for (int i = 0; i < _LOutputs.size(); i++) {
-                    int id = toID(_LOutputs[i]);
-                    writeSimValToGate(val, _gates[id], id);
-                }
-            }
-        }
-    }
-    if (Tmod32 != 0) {
-        for (int i = 0; i < _LInputs.size(); i++) {
-            int id = toID(_LInputs[i]);
-            val[id].v = 0;
-            for (int j = 0; j < 32; j++)
-                if (in[j][i] == '1') val[id].v |= setMask[j];
+            if (k == writeAt) writeGates(val[k]);
         }
-        doSim(val);
-        if (_simLog) {
-            for (int i = 0; i < 32; i++) {
-                for (int j = 0; j < _LInputs.size(); j++)
-                    valPI[j].push_back(val[toID(_LInputs[j])][i]);
-                for (int j = 0; j < _LOutputs.size(); j++)
-                    valPO[j].push_back(val[toID(_LOutputs[j])][i]);
-            }
+        writeAt = -1;
+        last = nb - 1;
+    };
+
+    while (patternFile >> in) {
+        if (Tmod == 0 && T != 0) {
+            vector<Val>& last = val[(b + nBlocks - 1) % nBlocks];
+            for (int i = 0; i < _LInputs.size(); i++)
+                val[b][toID(_LInputs[i])] = last[toID(_LInputs[i])];
         }
-        if(!wrote) {
-            for (int i = 0; i < _LAIGs.size(); i++) {
-                int id = toID(_LAIGs[i]);
-                if (active(id)) writeSimValToGate(val, _gates[id], id);
-            }
-            for (int i = 0; i < _LInputs.size(); i++) {
-                int id = toID(_LInputs[i]);
-                writeSimValToGate(val, _gates[id], id);
+        for (int i = 0; i < _LInputs.size(); i++)
+            val[b][toID(_LInputs[i])].set(Tmod,
+                                          i < in.size() && in[i] == '1');
+        ++T, ++Tmod;
+        if (Tmod == W) {
+            Tmod = 0;
+            if (T == W) {
+                wrote = true;
+                writeAt = b;
             }
-            for (int i = 0; i < _LOutputs.size(); i++) {
-                int id = toID(_LOutputs[i]);
-                writeSimValToGate(val, _gates[id], id);
+            if (++b == nBlocks) {
+                simulate(b);
+                b = 0;
             }
         }
     }
+    if (Tmod != 0) {
+        if (!wrote) writeAt = b;
+        simulate(b + 1);
+    } else if (b != 0) {
+        simulate(b);
+    }
+
+    if (_simWord.empty() && last >= 0) keepSimWord(val[last]);
 
     cout << T << " patterns simulated.\n";
-    _FECGroupList.sort();
 
     if (_simLog) {
+        BufWriter log(*_simLog);
         for (int i = 0; i < T; i++) {
             for (int j = 0; j < _LInputs.size(); j++)
-                (*_simLog) << valPI[j][i];
+                log << (valPI[j][i] ? '1' : '0');
 
-            (*_simLog) << " ";
+            log << ' ';
             for (int j = 0; j < _LOutputs.size(); j++)
-                (*_simLog) << valPO[j][i];
+                log << (valPO[j][i] ? '1' : '0');
 
-            (*_simLog) << endl;
+            log << '\n';
         }
     }
 
-    for (auto it = _FECGroupList.begin(); it != _FECGroupList.end(); ++it) {
-        auto& FECGroup = *it;
-        for (int lid : FECGroup) {
-            int id = toID(lid);
-            _gates[id]->_FECGroupIt = it;
-            _gates[id]->_FECInv = isInv(lid);
-        }
-    }
-}
-
-void CirMgr::simulationParallel(vector<SimValPar>& val, int id) {
-    if (visited(id)) return;
-    visit(id);
-
-    GateList& LFanIn = LFanInOf(id);
-    for (int i = 0; i < LFanIn.size(); i++) {
-        int id = toID(LFanIn[i]);
-        if (active(id) && !visited(id)) simulationParallel(val, id);
-    }
-
-    if (LFanIn.size() == 2) {
-        int lid0 = LFanIn[0];
-        int lid1 = LFanIn[1];
-        SimValPar::par_type mask0 = 0;
-        SimValPar::par_type mask1 = 0;
-
-        if (isInv(lid0)) mask0 = SimValPar::mask;
-        if (isInv(lid1)) mask1 = SimValPar::mask;
-        val[id].v = ((val[toID(lid0)].v ^ mask0) & (val[toID(lid1)].v ^ mask1));
-    } else if (LFanIn.size() == 1) {
-        int lid0 = LFanIn[0];
-        SimValPar::par_type mask0 = 0;
-        if (isInv(lid0)) mask0 = SimValPar::mask;
-        val[id].v = (val[toID(lid0)].v ^ mask0);
-    }
+    linkFECGroups();
 }
 
+template <class Val>
 void CirMgr::randomSimParallel() {
-    vector<SimValPar> val(size() + _LOutputs.size() + 1);
-    initSim(val);
+    const int W = Val::BITS;
+    ThreadPool pool(_simThreads);
+    int nBlocks = _simByLevel ? 1 : pool.size();
+    vector<vector<Val> > val(nBlocks,
+                             vector<Val>(size() + _LOutputs.size() + 1));
+    initSim(val[0]);
 
     vector<vector<bool>> valPI(_LInputs.size());
     vector<vector<bool>> valPO(_LOutputs.size());
@@ -254,119 +486,93 @@ void CirMgr::randomSimParallel() {
     int T = std::max(2000, (int)(5000 - 10 * sqrt(size())));
     if (_InputNum <= 10) T = std::min(1 << (_InputNum + 2), T);
 
-    int Tmod32 = 0;
-    vector<bool> in[32];
-    bool wrote = false;
-    for (int i = 0; i < 32; i++)
-        in[i].resize(_LInputs.size());
-    for (int Ti = 0; Ti < T; Ti++) {
-        for (int i = 0; i < _LInputs.size(); i++)
-            in[Tmod32][i] = rand() & 1;
-
-        ++Tmod32;
-        if (Tmod32 == 32) {
-            Tmod32 = 0;
-            for (int i = 0; i < _LInputs.size(); i++) {
-                int id = toID(_LInputs[i]);
-                val[id].v = 0;
-                for (int j = 0; j < 32; j++)
-                    if (in[j][i] == 1) val[id].v |= setMask[j];
-            }
-            doSim(val);
-            if (_simLog) {
-                for (int i = 0; i < 32; i++) {
-                    for (int j = 0; j < _LInputs.size(); j++)
-                        valPI[j].push_back(val[toID(_LInputs[j])][i]);
-                    for (int j = 0; j < _LOutputs.size(); j++)
-                        valPO[j].push_back(val[toID(_LOutputs[j])][i]);
-                }
-            }
+    // Patterns come in 64-pattern chunks, chunk c from stream c of the
+    // seed, so they depend on neither the word width nor the thread count.
+    // Each thread draws the inputs of the words it simulates. A chunk past
+    // the last one repeats the first chunk of its word: no new pattern.
+    const int N = W / 64, nChunks = (T + 63) / 64;
+    const int nWords = (nChunks + N - 1) / N;
+    const uint64_t seed = _simSeed++;
+    T = nChunks * 64;
+    auto fill = [&](vector<Val>& val, int g) {
+        for (int k = 0; k < N; k++) {
+            int c = g * N + k;
+            RandomGen rng(seed, c < nChunks ? c : g * N);
+            for (int i = 0; i < _LInputs.size(); i++)
+                val[toID(_LInputs[i])].v[k] = rng();
+        }
+    };
 
-            if (T == 32) {
-                wrote = true;
-                for (int i = 0; i < _LAIGs.size(); i++) {
-                    int id = toID(_LAIGs[i]);
-                    if (active(id)) writeSimValToGate(val, _gates[id], id);
-                }
-                for (int i = 0; i < _LInputs.size(); i++) {
-                    int id = toID(_LInputs[i]);
-                    writeSimValToGate(val, _gates[id], id);
-                }
-                for (int i = 0; i < _LOutputs.size(); i++) {
-                    int id = toID(_LOutputs[i]);
-                    writeSimValToGate(val, _gates[id], id);
-                }
-            }
+    int writeAt = -1;
+    auto writeGates = [&](vector<Val>& val) {
+        for (int i = 0; i < _LAIGs.size(); i++) {
+            int id = toID(_LAIGs[i]);
+            if (active(id)) writeSimValToGate(val, _gates[id], id);
         }
-    }
-    if (Tmod32 != 0) {
         for (int i = 0; i < _LInputs.size(); i++) {
             int id = toID(_LInputs[i]);
-            val[id].v = 0;
-            for (int j = 0; j < 32; j++)
-                if (in[j][i] == 1) val[id].v |= setMask[j];
+            writeSimValToGate(val, _gates[id], id);
         }
-        doSim(val);
-        if (_simLog) {
-            for (int i = 0; i < 32; i++) {
-                for (int j = 0; j < _LInputs.size(); j++)
-                    valPI[j].push_back(val[toID(_LInputs[j])][i]);
-                for (int j = 0; j < _LOutputs.size(); j++)
-                    valPO[j].push_back(val[toID(_LOutputs[j])][i]);
-            }
+        for (int i = 0; i < _LOutputs.size(); i++) {
+            int id = toID(_LOutputs[i]);
+            writeSimValToGate(val, _gates[id], id);
         }
-        if(!wrote) {
-            for (int i = 0; i < _LAIGs.size(); i++) {
-                int id = toID(_LAIGs[i]);
-                if (active(id)) writeSimValToGate(val, _gates[id], id);
-            }
-            for (int i = 0; i < _LInputs.size(); i++) {
-                int id = toID(_LInputs[i]);
-                writeSimValToGate(val, _gates[id], id);
-            }
-            for (int i = 0; i < _LOutputs.size(); i++) {
-                int id = toID(_LOutputs[i]);
-                writeSimValToGate(val, _gates[id], id);
+        keepSimWord(val);
+    };
+    auto simulate = [&](int nb, int g) {
+        pool.run([&](size_t t) {
+            for (size_t b = t; b < nb; b += pool.size()) fill(val[b], g + b);
+        });
+        evalSim(val, nb, pool);
+        for (int k = 0; k < nb; k++) {
+            refineFEC(val[k].data());
+            if (_simLog) {
+                for (int i = 0; i < W; i++) {
+                    for (int j = 0; j < _LInputs.size(); j++)
+                        valPI[j].push_back(val[k][toID(_LInputs[j])][i]);
+                    for (int j = 0; j < _LOutputs.size(); j++)
+                        valPO[j].push_back(val[k][toID(_LOutputs[j])][i]);
+                }
             }
+            if (k == writeAt) writeGates(val[k]);
         }
+        writeAt = -1;
+    };
+
+    for (int g = 0; g < nWords; g += nBlocks) {
+        int nb = std::min(nBlocks, nWords - g);
+        // the gates keep values from the last word simulated
+        if (g + nb == nWords) writeAt = nb - 1;
+        simulate(nb, g);
     }
 
     cout << T << " patterns simulated.\n";
-    _FECGroupList.sort();
 
     if (_simLog) {
+        BufWriter log(*_simLog);
         for (int i = 0; i < T; i++) {
             for (int j = 0; j < _LInputs.size(); j++)
-                (*_simLog) << valPI[j][i];
+                log << (valPI[j][i] ? '1' : '0');
 
-            (*_simLog) << " ";
+            log << ' ';
             for (int j = 0; j < _LOutputs.size(); j++)
-                (*_simLog) << valPO[j][i];
+                log << (valPO[j][i] ? '1' : '0');
 
-            (*_simLog) << endl;
+            log << '\n';
         }
     }
 
-    for (auto it = _FECGroupList.begin(); it != _FECGroupList.end(); ++it) {
-        auto& FECGroup = *it;
-        for (int lid : FECGroup) {
-            int id = toID(lid);
-            _gates[id]->_FECGroupIt = it;
-            _gates[id]->_FECInv = isInv(lid);
-        }
-    }
+    linkFECGroups();
 }
 
-void CirMgr::doSim(vector<SimValPar>& val) {
-    resetVisit();
-    for (int i = 0; i < _LOutputs.size(); i++)
-        simulationParallel(val, toID(_LOutputs[i]));
+template <class Val>
+void CirMgr::refineFEC(const Val* val) {
 
     auto FECGroupIt = _FECGroupList.begin();
     auto newGroupIt = _FECGroupList.end();
     int sz = _FECGroupList.size();
 
-    HashMap<SimValPar, list<list<int>>::iterator> newGroupMap(32);
+    HashMap<Val, list<list<int>>::iterator> newGroupMap(32);
     for (int idxOfList = 0; idxOfList < sz; ++idxOfList) {
         list<int>& FECGroup = *FECGroupIt;
         if (FECGroup.size() == 1) {
@@ -378,34 +584,40 @@ void CirMgr::doSim(vector<SimValPar>& val) {
 
         int idxInList = 0;
         newGroupIt = _FECGroupList.end();
-        int pivot = 0;
+        Val pivot;
 
-        newGroupMap.clear();
+        // a wide word splits a big group into many; size the buckets to it
+        if (FECGroup.size() > 1024)
+            newGroupMap.init(FECGroup.size() / 8);
+        else if (newGroupMap.numBuckets() != 32)
+            newGroupMap.init(32);
+        else
+            newGroupMap.clear();
         for (auto it = FECGroup.begin(); it != FECGroup.end();) {
             int lid = *it;
             int id = toID(lid);
             if (idxInList == 0) {
-                pivot = val[id].v;
+                pivot = val[id];
                 ++it;
-            } else if (!isInv(lid) && val[id].v == pivot) {
+            } else if (!isInv(lid) && val[id] == pivot) {
                 ++it;
-            } else if (isInv(lid) && (~val[id].v) == pivot) {
+            } else if (isInv(lid) && ~val[id] == pivot) {
                 ++it;
-            } else if ((!isInv(lid) && (~val[id].v) == pivot) ||
-                       (isInv(lid) && val[id].v == pivot)) {
+            } else if ((!isInv(lid) && ~val[id] == pivot) ||
+                       (isInv(lid) && val[id] == pivot)) {
                 *it ^= 1;
                 ++it;
             } else {
                 bool invVal = false;
                 bool found = false;
                 if (newGroupMap.count(val[id]) ||
-                    (invVal = newGroupMap.count(SimValPar(~val[id].v)))) {
+                    (invVal = newGroupMap.count(~val[id]))) {
                     found = true;
                     if (!invVal) {
                         auto itNew = newGroupMap[val[id]];
                         (*itNew).push_back(toLID(id, invVal));
                     } else {
-                        auto itNew = newGroupMap[SimValPar(~val[id].v)];
+                        auto itNew = newGroupMap[~val[id]];
                         (*itNew).push_back(toLID(id, invVal));
                     }
                 }
@@ -0,0 +1,74 @@
+/****************************************************************************
+  FileName     [ memMgr.h ]
+  PackageName  [ util ]
+  Synopsis     [ Define a block arena for objects of one type ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2007-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+
+#ifndef MEM_MGR_H
+#define MEM_MGR_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+using namespace std;
+
+// MemMgr<T> hands out memory for T objects from blocks of blockSize bytes:
+// alloc() bumps a pointer in the current block and opens a new block when
+// it is full. Nothing is freed one by one; reset() rewinds the first block
+// and frees the others, so releasing n objects costs O(blocks). No
+// destructor is run, so a T placed here must not own other memory.
+template <class T>
+class MemMgr {
+   public:
+    MemMgr(size_t blockSize = 65536)
+        : _blockSize(max(blockSize, slot(sizeof(T)))) {
+        newBlock();
+    }
+    ~MemMgr() {
+        for (size_t i = 0; i < _blocks.size(); ++i)
+            ::operator delete(_blocks[i]);
+    }
+
+    void* alloc(size_t t) {
+        t = slot(t);
+        assert(t <= _blockSize);
+        if ((size_t)(_end - _ptr) < t) newBlock();
+        void* p = _ptr;
+        _ptr += t;
+        return p;
+    }
+    void reset() {
+        for (size_t i = 1; i < _blocks.size(); ++i)
+            ::operator delete(_blocks[i]);
+        _blocks.resize(1);
+        _ptr = _blocks[0];
+        _end = _ptr + _blockSize;
+    }
+    size_t numBlocks() const { return _blocks.size(); }
+
+   private:
+    MemMgr(const MemMgr&);
+    MemMgr& operator=(const MemMgr&);
+
+    // t bytes rounded up so that every slot stays aligned for T
+    static size_t slot(size_t t) {
+        return (t + alignof(T) - 1) / alignof(T) * alignof(T);
+    }
+    void newBlock() {
+        _blocks.push_back((char*)::operator new(_blockSize));
+        _ptr = _blocks.back();
+        _end = _ptr + _blockSize;
+    }
+
+    size_t _blockSize;
+    vector<char*> _blocks;
+    char* _ptr;
+    char* _end;
+};
+
+#endif  // MEM_MGR_H
@@ -0,0 +1,53 @@
+/****************************************************************************
+  FileName     [ myRandom.h ]
+  PackageName  [ util ]
+  Synopsis     [ Define a seedable 64-bit random word generator ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2009-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+
+#ifndef MY_RANDOM_H
+#define MY_RANDOM_H
+
+#include <stdint.h>
+
+// RandomGen is xoshiro256**: each call returns 64 random bits. The state is
+// filled by splitmix64 from (seed, stream), so the same pair always gives
+// the same words and different streams of one seed can be drawn
+// independently, e.g. one per simulation word on different threads.
+class RandomGen {
+   public:
+    RandomGen(uint64_t seed = 0, uint64_t stream = 0) {
+        uint64_t x = mix(seed) + stream * 0x9e3779b97f4a7c15ULL;
+        for (int i = 0; i < 4; ++i) _s[i] = splitmix(x);
+    }
+
+    uint64_t operator()() {
+        uint64_t r = rotl(_s[1] * 5, 7) * 9;
+        uint64_t t = _s[1] << 17;
+        _s[2] ^= _s[0];
+        _s[3] ^= _s[1];
+        _s[1] ^= _s[2];
+        _s[0] ^= _s[3];
+        _s[2] ^= t;
+        _s[3] = rotl(_s[3], 45);
+        return r;
+    }
+
+   private:
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+    static uint64_t splitmix(uint64_t& x) {
+        return mix(x += 0x9e3779b97f4a7c15ULL);
+    }
+
+    uint64_t _s[4];
+};
+
+#endif  // MY_RANDOM_H
@@ -0,0 +1,141 @@
+/****************************************************************************
+  FileName     [ myThreadPool.h ]
+  PackageName  [ util ]
+  Synopsis     [ Define a fork/join thread pool and a bounded queue ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2009-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+
+#ifndef MY_THREAD_POOL_H
+#define MY_THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// ThreadPool(n) keeps n - 1 worker threads alive; run(fn) calls fn(i) for
+// every i in [0, n) in parallel (the caller itself runs i = 0) and returns
+// when all of them are done. Workers sleep between calls, so a pool can be
+// reused for many short parallel steps.
+class ThreadPool {
+   public:
+    ThreadPool(size_t n = 1)
+        : _size(n ? n : 1), _job(0), _round(0), _pending(0), _stop(false) {
+        for (size_t i = 1; i < _size; ++i)
+            _threads.push_back(thread(&ThreadPool::worker, this, i));
+    }
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(_mutex);
+            _stop = true;
+        }
+        _start.notify_all();
+        for (size_t i = 0; i < _threads.size(); ++i)
+            _threads[i].join();
+    }
+
+    size_t size() const { return _size; }
+
+    void run(const function<void(size_t)>& fn) {
+        if (_size == 1) {
+            fn(0);
+            return;
+        }
+        {
+            lock_guard<mutex> lock(_mutex);
+            _job = &fn;
+            _pending = _size - 1;
+            ++_round;
+        }
+        _start.notify_all();
+        fn(0);
+        unique_lock<mutex> lock(_mutex);
+        _done.wait(lock, [this] { return _pending == 0; });
+        _job = 0;
+    }
+
+    // Split [0, n) into size() contiguous ranges and run fn(begin, end)
+    void parallelFor(size_t n, const function<void(size_t, size_t)>& fn) {
+        size_t step = (n + _size - 1) / _size;
+        run([&](size_t i) {
+            size_t b = i * step, e = min(n, b + step);
+            if (b < e) fn(b, e);
+        });
+    }
+
+   private:
+    void worker(size_t i) {
+        size_t seen = 0;
+        while (true) {
+            const function<void(size_t)>* job;
+            {
+                unique_lock<mutex> lock(_mutex);
+                _start.wait(lock, [&] { return _stop || _round != seen; });
+                if (_stop) return;
+                seen = _round;
+                job = _job;
+            }
+            (*job)(i);
+            {
+                lock_guard<mutex> lock(_mutex);
+                if (--_pending == 0) _done.notify_one();
+            }
+        }
+    }
+
+    size_t _size;
+    vector<thread> _threads;
+    mutex _mutex;
+    condition_variable _start;
+    condition_variable _done;
+    const function<void(size_t)>* _job;
+    size_t _round;
+    size_t _pending;
+    bool _stop;
+};
+
+// BoundedQueue(n) hands items from one thread to another; push() blocks
+// while n items are waiting, pop() blocks while the queue is empty and
+// returns false once it is empty and close() has been called.
+template <class T>
+class BoundedQueue {
+   public:
+    BoundedQueue(size_t n) : _cap(n ? n : 1), _closed(false) {}
+
+    void push(T& t) {
+        unique_lock<mutex> lock(_mutex);
+        _notFull.wait(lock, [this] { return _items.size() < _cap; });
+        _items.push_back(move(t));
+        _notEmpty.notify_one();
+    }
+    bool pop(T& t) {
+        unique_lock<mutex> lock(_mutex);
+        _notEmpty.wait(lock, [this] { return _closed || !_items.empty(); });
+        if (_items.empty()) return false;
+        t = move(_items.front());
+        _items.pop_front();
+        _notFull.notify_one();
+        return true;
+    }
+    void close() {
+        lock_guard<mutex> lock(_mutex);
+        _closed = true;
+        _notEmpty.notify_all();
+    }
+
+   private:
+    size_t _cap;
+    deque<T> _items;
+    mutex _mutex;
+    condition_variable _notFull;
+    condition_variable _notEmpty;
+    bool _closed;
+};
+
+#endif  // MY_THREAD_POOL_H
@@ -0,0 +1,78 @@
+/****************************************************************************
+  FileName     [ myWriter.h ]
+  PackageName  [ util ]
+  Synopsis     [ Define a large-buffer text writer with fast formatting ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2009-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+
+#ifndef MY_WRITER_H
+#define MY_WRITER_H
+
+#include <cstring>
+#include <ostream>
+#include <string>
+
+using namespace std;
+
+// BufWriter collects output in a 1MB buffer and hands it to the ostream in
+// one write() when the buffer fills up or the writer goes out of scope.
+// Integers are formatted by hand and "\n" never flushes, so dumping a big
+// netlist or simulation log costs a handful of write() calls instead of
+// one formatted insertion (and one flush per endl) per token.
+class BufWriter {
+   public:
+    BufWriter(ostream& os) : _os(os), _buf(new char[BUF_SIZE]), _p(_buf) {}
+    ~BufWriter() {
+        flush();
+        delete[] _buf;
+    }
+
+    void flush() {
+        if (_p != _buf) _os.write(_buf, _p - _buf);
+        _p = _buf;
+    }
+
+    BufWriter& operator<<(char c) {
+        if (_p == _buf + BUF_SIZE) flush();
+        *_p++ = c;
+        return *this;
+    }
+    BufWriter& operator<<(const char* s) { return write(s, strlen(s)); }
+    BufWriter& operator<<(const string& s) { return write(s.data(), s.size()); }
+    BufWriter& operator<<(unsigned n) {
+        char tmp[16], *q = tmp + sizeof(tmp);
+        do {
+            *--q = '0' + n % 10;
+        } while (n /= 10);
+        return write(q, tmp + sizeof(tmp) - q);
+    }
+    BufWriter& operator<<(int n) {
+        if (n >= 0) return *this << (unsigned)n;
+        return *this << '-' << (0u - (unsigned)n);
+    }
+    BufWriter& operator<<(size_t n) { return *this << (unsigned)n; }
+    BufWriter& operator<<(bool b) { return *this << (b ? '1' : '0'); }
+
+    BufWriter& write(const char* s, size_t n) {
+        if (_p + n > _buf + BUF_SIZE) {
+            flush();
+            if (n > BUF_SIZE) {
+                _os.write(s, n);
+                return *this;
+            }
+        }
+        memcpy(_p, s, n);
+        _p += n;
+        return *this;
+    }
+
+   private:
+    enum { BUF_SIZE = 1 << 20 };
+
+    ostream& _os;
+    char* _buf;
+    char* _p;
+};
+
+#endif  // MY_WRITER_H
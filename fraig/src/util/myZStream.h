@@ -0,0 +1,170 @@
+/****************************************************************************
+  FileName     [ myZStream.h ]
+  PackageName  [ util ]
+  Synopsis     [ Define an input stream that inflates compressed files ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2009-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+
+#ifndef MY_Z_STREAM_H
+#define MY_Z_STREAM_H
+
+#include <zlib.h>
+#include <cstdio>
+#include <cstring>
+#include <istream>
+#include <streambuf>
+#include <string>
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace std;
+
+// ZInStream reads a file through a streaming decompressor chosen by its
+// magic bytes: gzip (and plain files) go through zlib, zstd through libzstd
+// when compiled with -DUSE_ZSTD (link -lzstd). Data is inflated in 64KB
+// pieces on demand, so nothing is staged on disk or fully in memory.
+class ZInBuf : public streambuf {
+   public:
+    ZInBuf() : _gz(0), _fp(0), _total(0) {
+#ifdef USE_ZSTD
+        _zs = 0;
+#endif
+    }
+    ~ZInBuf() { close(); }
+
+    static bool isGzip(const unsigned char* m) {
+        return m[0] == 0x1f && m[1] == 0x8b;
+    }
+    static bool isZstd(const unsigned char* m) {
+        return m[0] == 0x28 && m[1] == 0xb5 && m[2] == 0x2f && m[3] == 0xfd;
+    }
+    static bool isCompressed(const string& fileName) {
+        unsigned char m[4] = {0};
+        FILE* fp = fopen(fileName.c_str(), "rb");
+        if (!fp) return false;
+        size_t n = fread(m, 1, 4, fp);
+        fclose(fp);
+        return n >= 2 && (isGzip(m) || (n == 4 && isZstd(m)));
+    }
+
+    bool open(const string& fileName) {
+        close();
+        unsigned char m[4] = {0};
+        if (!(_fp = fopen(fileName.c_str(), "rb"))) return false;
+        size_t n = fread(m, 1, 4, _fp);
+        if (n == 4 && isZstd(m)) {
+#ifdef USE_ZSTD
+            rewind(_fp);
+            _zs = ZSTD_createDStream();
+            ZSTD_initDStream(_zs);
+            _in.src = _inBuf, _in.size = _in.pos = 0;
+            return true;
+#else
+            close();
+            return false;
+#endif
+        }
+        fclose(_fp), _fp = 0;
+        if (!(_gz = gzopen(fileName.c_str(), "rb"))) return false;
+        gzbuffer(_gz, BUF_SIZE);
+        return true;
+    }
+    void close() {
+        if (_gz) gzclose(_gz), _gz = 0;
+        if (_fp) fclose(_fp), _fp = 0;
+#ifdef USE_ZSTD
+        if (_zs) ZSTD_freeDStream(_zs), _zs = 0;
+#endif
+        setg(_buf, _buf, _buf);
+        _total = 0;
+    }
+    bool is_open() const { return _gz || _fp; }
+
+    // copy (at most n of) the next bytes without consuming them
+    size_t peekBytes(char* dst, size_t n) {
+        if (gptr() == egptr() && underflow() == traits_type::eof()) return 0;
+        n = min(n, (size_t)(egptr() - gptr()));
+        memcpy(dst, gptr(), n);
+        return n;
+    }
+
+   protected:
+    int_type underflow() {
+        if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+        size_t n = inflate(_buf, BUF_SIZE);
+        _total += n;
+        setg(_buf, _buf, _buf + n);
+        return n ? traits_type::to_int_type(*gptr()) : traits_type::eof();
+    }
+    // only tellg() is supported: the offset in the inflated data
+    pos_type seekoff(off_type off, ios_base::seekdir dir,
+                     ios_base::openmode) {
+        if (off != 0 || dir != ios_base::cur) return pos_type(off_type(-1));
+        return pos_type(off_type(_total - (egptr() - gptr())));
+    }
+
+   private:
+    enum { BUF_SIZE = 1 << 16 };
+
+    size_t inflate(char* dst, size_t size) {
+        if (_gz) {
+            int n = gzread(_gz, dst, size);
+            return n > 0 ? n : 0;
+        }
+#ifdef USE_ZSTD
+        if (_zs) {
+            ZSTD_outBuffer out = {dst, size, 0};
+            while (out.pos == 0) {
+                if (_in.pos == _in.size) {
+                    _in.size = fread(_inBuf, 1, BUF_SIZE, _fp), _in.pos = 0;
+                    if (_in.size == 0) break;
+                }
+                if (ZSTD_isError(ZSTD_decompressStream(_zs, &out, &_in)))
+                    break;
+            }
+            return out.pos;
+        }
+#endif
+        return 0;
+    }
+
+    gzFile _gz;
+    FILE* _fp;
+    size_t _total;
+    char _buf[BUF_SIZE];
+#ifdef USE_ZSTD
+    ZSTD_DStream* _zs;
+    ZSTD_inBuffer _in;
+    char _inBuf[BUF_SIZE];
+#endif
+};
+
+class ZInStream : public istream {
+   public:
+    ZInStream() : istream(&_buf) {}
+    ZInStream(const string& fileName) : istream(&_buf) { open(fileName); }
+
+    void open(const string& fileName) {
+        if (_buf.open(fileName))
+            clear();
+        else
+            setstate(ios::failbit);
+    }
+    void close() { _buf.close(); }
+    bool is_open() const { return _buf.is_open(); }
+    size_t peekBytes(char* dst, size_t n) { return _buf.peekBytes(dst, n); }
+
+    // inflate everything that is left into s
+    void readAll(string& s) {
+        char tmp[1 << 16];
+        while (read(tmp, sizeof(tmp)) || gcount())
+            s.append(tmp, gcount());
+    }
+
+   private:
+    ZInBuf _buf;
+};
+
+#endif  // MY_Z_STREAM_H